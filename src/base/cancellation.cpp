@@ -0,0 +1,42 @@
+//  Created by Alberto Santini on 18/09/13.
+//  Copyright (c) 2013 Alberto Santini. All rights reserved.
+//
+
+#include <algorithm>
+
+#include "cancellation.h"
+
+namespace mvrp {
+    std::atomic<bool> CancellationToken::termination_requested{false};
+
+    CancellationToken::CancellationToken() : flags{std::make_shared<std::atomic<bool>>(false)}, deadline{boost::none} {}
+
+    CancellationToken CancellationToken::child() const {
+        CancellationToken token = *this;
+        token.flags.push_back(std::make_shared<std::atomic<bool>>(false));
+        return token;
+    }
+
+    CancellationToken CancellationToken::with_deadline(double seconds) const {
+        CancellationToken token = child();
+        auto new_deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+
+        token.deadline = deadline ? std::min(*deadline, new_deadline) : new_deadline;
+
+        return token;
+    }
+
+    void CancellationToken::cancel() const {
+        flags.back()->store(true);
+    }
+
+    bool CancellationToken::is_cancelled() const {
+        if(termination_requested.load()) { return true; }
+        if(std::any_of(flags.begin(), flags.end(), [] (const auto& f) { return f->load(); })) { return true; }
+        return deadline && Clock::now() >= *deadline;
+    }
+
+    void CancellationToken::request_termination() {
+        termination_requested.store(true);
+    }
+}
@@ -0,0 +1,65 @@
+//  Created by Alberto Santini on 18/09/13.
+//  Copyright (c) 2013 Alberto Santini. All rights reserved.
+//
+
+#ifndef CANCELLATION_H
+#define CANCELLATION_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+namespace mvrp {
+    /**
+     * Token used to ask long-running computations to stop as soon as possible. A token is cancelled
+     * when it, or any of the tokens it was derived from, has been cancelled explicitly, when its deadline
+     * has passed, or when the process has been asked to terminate. Copies share the same state.
+     */
+    class CancellationToken {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        CancellationToken();
+
+        /**
+         * Gives a new token, which is cancelled when this one is. Cancelling the new token
+         * does not cancel this one.
+         * @return          The new token
+         */
+        CancellationToken child() const;
+
+        /**
+         * Gives a new token, which is cancelled when this one is, or after a certain time.
+         * Cancelling the new token does not cancel this one.
+         * @param seconds   Seconds from now after which the new token is cancelled
+         * @return          The new token
+         */
+        CancellationToken with_deadline(double seconds) const;
+
+        /**
+         * Cancels this token, and all the tokens derived from it.
+         */
+        void cancel() const;
+
+        /**
+         * Checks whether the computation should stop.
+         */
+        bool is_cancelled() const;
+
+        /**
+         * Cancels all tokens. It is safe to call it from a signal handler.
+         */
+        static void request_termination();
+
+    private:
+        std::vector<std::shared_ptr<std::atomic<bool>>> flags;
+        boost::optional<Clock::time_point> deadline;
+
+        static std::atomic<bool> termination_requested;
+    };
+}
+
+#endif
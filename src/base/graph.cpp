@@ -7,6 +7,7 @@
 #include <limits>
 #include <stdexcept>
 #include <fstream>
+#include <map>
 
 #include "graph.h"
 
@@ -97,6 +98,37 @@ namespace mvrp {
         }
     }
 
+    void Graph::sort_adjacency() {
+        auto n_vertices = num_vertices(graph);
+
+        sorted_out_edges = std::vector<std::vector<Edge>>(n_vertices);
+        sorted_in_edges = std::vector<std::vector<Edge>>(n_vertices);
+
+        auto sort_by_rc = [this] (std::vector<Edge>& edges, bool by_target) {
+            auto rc = std::vector<std::pair<double, Edge>>();
+            rc.reserve(edges.size());
+
+            for(const auto& e : edges) {
+                const Node& n = *graph[by_target ? target(e, graph) : source(e, graph)];
+                rc.push_back(std::make_pair(graph[e]->cost - dual_of(n), e));
+            }
+
+            std::stable_sort(rc.begin(), rc.end(), [] (const auto& rc1, const auto& rc2) { return rc1.first > rc2.first; });
+
+            for(auto i = 0u; i < edges.size(); i++) { edges[i] = rc[i].second; }
+        };
+
+        for(auto vp = vertices(graph); vp.first != vp.second; ++vp.first) {
+            auto id = graph[*vp.first]->boost_vertex_id;
+
+            for(auto oe = out_edges(*vp.first, graph); oe.first != oe.second; ++oe.first) { sorted_out_edges[id].push_back(*oe.first); }
+            for(auto ie = in_edges(*vp.first, graph); ie.first != ie.second; ++ie.first) { sorted_in_edges[id].push_back(*ie.first); }
+
+            sort_by_rc(sorted_out_edges[id], true);
+            sort_by_rc(sorted_in_edges[id], false);
+        }
+    }
+
     std::pair<bool, Vertex> Graph::get_source_vertex() const {
         return get_vertex_by_node_type(NodeType::SOURCE_VERTEX);
     }
@@ -114,15 +146,62 @@ namespace mvrp {
 
     void Graph::prepare_for_labelling() {
         auto i = 0;
+        auto port_indices = std::map<Port*, int>();
+
+        port_index = std::vector<int>(num_vertices(graph), -1);
 
         for(auto vp = vertices(graph); vp.first != vp.second; ++vp.first) {
-            graph[*vp.first]->boost_vertex_id = i++;
+            const auto& n = graph[*vp.first];
+            n->boost_vertex_id = i++;
+
+            if(n->n_type == NodeType::REGULAR_PORT) {
+                port_index[n->boost_vertex_id] = port_indices.emplace(n->port.get(), (int) port_indices.size()).first->second;
+            }
         }
 
+        n_ports = port_indices.size();
+
         i = 0;
         for(auto ep = edges(graph); ep.first != ep.second; ++ep.first) {
             graph[*ep.first]->boost_edge_id = i++;
         }
+
+        // The level of a vertex is the length of the longest path reaching it
+        auto remaining_in_edges = std::vector<int>(num_vertices(graph));
+        auto level = std::vector<int>(num_vertices(graph), 0);
+        auto to_visit = std::vector<Vertex>();
+
+        for(auto vp = vertices(graph); vp.first != vp.second; ++vp.first) {
+            remaining_in_edges[graph[*vp.first]->boost_vertex_id] = in_degree(*vp.first, graph);
+            if(in_degree(*vp.first, graph) == 0) { to_visit.push_back(*vp.first); }
+        }
+
+        topological_levels.clear();
+
+        auto n_visited = 0u;
+        while(!to_visit.empty()) {
+            auto v = to_visit.back();
+            auto v_level = level[graph[v]->boost_vertex_id];
+            to_visit.pop_back();
+            n_visited++;
+
+            if((int) topological_levels.size() <= v_level) { topological_levels.resize(v_level + 1); }
+            topological_levels[v_level].push_back(v);
+
+            for(auto oe = out_edges(v, graph); oe.first != oe.second; ++oe.first) {
+                auto w_id = graph[target(*oe.first, graph)]->boost_vertex_id;
+                level[w_id] = std::max(level[w_id], v_level + 1);
+                if(--remaining_in_edges[w_id] == 0) { to_visit.push_back(target(*oe.first, graph)); }
+            }
+        }
+
+        if(n_visited != num_vertices(graph)) { throw std::runtime_error("The graph is not acyclic"); }
+
+        // Keep vertices within a level in a deterministic order
+        for(auto& vertices_in_level : topological_levels) {
+            std::sort(vertices_in_level.begin(), vertices_in_level.end(),
+                      [this] (const Vertex& v1, const Vertex& v2) { return graph[v1]->boost_vertex_id < graph[v2]->boost_vertex_id; });
+        }
     }
 
 //    ErasedEdges Graph::get_erased_edges_from_rules(ErasedEdges already_erased, const VisitRuleList& unite_rules, const VisitRuleList& separate_rules) const {
@@ -210,7 +289,7 @@ namespace mvrp {
         return erased;
     }
 
-    ErasedEdges Graph::smart_reduce_graph(double min_chance, double max_chance, ErasedEdges already_erased) const {
+    ErasedEdges Graph::smart_reduce_graph(double min_chance, double max_chance, ErasedEdges already_erased, TaskRng rng) const {
         ErasedEdges erased = already_erased;
 
         auto max_prize = max_dual_prize();
@@ -224,7 +303,7 @@ namespace mvrp {
             if(trgt.n_type == NodeType::REGULAR_PORT) {
                 auto dual_prize = dual_of(trgt);
                 auto threshold = min_chance + (dual_prize - min_prize) * (max_chance - min_chance) / (max_prize - min_prize);
-                auto rnd = static_cast<double>(rand()) / static_cast<double>(RAND_MAX);
+                auto rnd = rng.uniform();
                 if(rnd > threshold) {
                     const Vertex &src = source(*ei, graph);
                     if(erased.find(src) == erased.end()) { erased[src] = std::set<Edge>(); }
@@ -236,6 +315,54 @@ namespace mvrp {
         return erased;
     }
 
+    ErasedEdges Graph::sparsify_graph(unsigned int max_out_arcs, ErasedEdges already_erased, TaskPool* pool) const {
+        ErasedEdges erased = already_erased;
+
+        auto vertex_list = std::vector<Vertex>();
+        for(auto vp = vertices(graph); vp.first != vp.second; ++vp.first) { vertex_list.push_back(*vp.first); }
+
+        auto is_erased = std::vector<char>(num_edges(graph), 0);
+        for(const auto& ve : already_erased) {
+            for(const auto& e : ve.second) { is_erased[graph[e]->boost_edge_id] = 1; }
+        }
+
+        auto removed = std::vector<std::vector<Edge>>(vertex_list.size());
+
+        auto sparsify_vertex = [&] (std::size_t i) {
+            auto rc = std::vector<std::pair<double, Edge>>();
+
+            for(auto oe = out_edges(vertex_list[i], graph); oe.first != oe.second; ++oe.first) {
+                if(is_erased[graph[*oe.first]->boost_edge_id]) { continue; }
+
+                const Node& trgt = *graph[target(*oe.first, graph)];
+                if(trgt.n_type != NodeType::REGULAR_PORT) { continue; }
+
+                rc.push_back(std::make_pair(graph[*oe.first]->cost - dual_of(trgt), *oe.first));
+            }
+
+            if(rc.size() <= max_out_arcs) { return; }
+
+            // We only need to know which arcs are the cheapest, not their order
+            std::nth_element(rc.begin(), rc.begin() + max_out_arcs, rc.end(),
+                             [] (const auto& rc1, const auto& rc2) { return rc1.first < rc2.first; });
+
+            for(auto j = max_out_arcs; j < rc.size(); j++) { removed[i].push_back(rc[j].second); }
+        };
+
+        if(pool) {
+            pool->parallel_for(vertex_list.size(), sparsify_vertex);
+        } else {
+            for(auto i = 0u; i < vertex_list.size(); i++) { sparsify_vertex(i); }
+        }
+
+        for(auto i = 0u; i < vertex_list.size(); i++) {
+            if(removed[i].empty()) { continue; }
+            erased[vertex_list[i]].insert(removed[i].begin(), removed[i].end());
+        }
+
+        return erased;
+    }
+
     double Graph::max_dual_prize() const {
         double max_prize = 0;
 
@@ -5,6 +5,7 @@
 #ifndef GRAPH_H
 #define GRAPH_H
 
+#include <cstddef>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -18,6 +19,8 @@
 #include "arc.h"
 #include "graph_properties.h"
 #include "node.h"
+#include "task_pool.h"
+#include "task_rng.h"
 #include "vessel_class.h"
 
 namespace mvrp {
@@ -50,13 +53,34 @@ namespace mvrp {
          */
         std::vector<std::shared_ptr<Arc>> ordered_arcs;
 
-        Graph() {}
+        /**
+         * Vertices grouped by topological level: each edge goes from a vertex in a level to a vertex in
+         * a strictly later level. Vertices in the same level are independent from each other.
+         */
+        std::vector<std::vector<Vertex>> topological_levels;
+
+        /**
+         * Index of the port of each vertex, by vertex id, for regular port vertices; -1 for the others.
+         * Ports are numbered from 0 to n_ports - 1.
+         */
+        std::vector<int> port_index;
+        std::size_t n_ports;
+
+        /**
+         * Out-edges (resp. in-edges) of each vertex, by vertex id, sorted by the reduced cost of the
+         * edge including the dual prize at their target (resp. source). The edges with the highest reduced
+         * cost come first: this is the order in which the greedy heuristics have always picked edges.
+         */
+        std::vector<std::vector<Edge>> sorted_out_edges;
+        std::vector<std::vector<Edge>> sorted_in_edges;
+
+        Graph() : n_ports{0u} {}
 
         Graph(const BGraph& graph, std::shared_ptr<VesselClass> vessel_class) :
-            graph(graph), vessel_class(vessel_class) {}
+            graph(graph), vessel_class(vessel_class), n_ports{0u} {}
 
         Graph(BGraph&& graph, std::shared_ptr<VesselClass> vessel_class) :
-            graph(graph), vessel_class(vessel_class) {}
+            graph(graph), vessel_class(vessel_class), n_ports{0u} {}
 
         /**
          * Prints basic information about the graph.
@@ -76,6 +100,12 @@ namespace mvrp {
          */
         void sort_arcs();
 
+        /**
+         * Fills sorted_out_edges and sorted_in_edges, using the current duals. It must be
+         * called again every time the duals change.
+         */
+        void sort_adjacency();
+
         /**
          * Finds the source vertex.
          * @return  A pair where the first element is true iff the source vertex has been found
@@ -102,9 +132,8 @@ namespace mvrp {
         std::pair<bool, Vertex> get_vertex(const Port& p, PortType pu, int t) const;
 
         /**
-         * Prepares the graph for labelling: adds unique consecutive ids to vertices and edges
-         * and computes upper bounds on the number of pickup and delivery ports that the associated
-         * vessel can visit.
+         * Prepares the graph for labelling: adds unique consecutive ids to vertices and edges,
+         * groups the vertices by topological level and numbers the ports.
          */
         void prepare_for_labelling();
 
@@ -143,9 +172,22 @@ namespace mvrp {
          * @param min_chance        Probability that the cheapest arc is removed
          * @param max_chance        Probability that the most expensive arc is removed
          * @param already_erased    List of edges which have already been removed
+         * @param rng               Random number generator deciding which arcs are removed
+         * @return                  List of all edges to remove
+         */
+        ErasedEdges smart_reduce_graph(double min_chance, double max_chance, ErasedEdges already_erased, TaskRng rng) const;
+
+        /**
+         * Gives a list of edges that need to be removed so that, out of every vertex, only the
+         * ``max_out_arcs'' remaining arcs to regular ports with the lowest reduced cost (using the
+         * current duals) are kept. Arcs to the hubs are always kept, so that paths can be completed.
+         * It must be called again every time the duals change.
+         * @param max_out_arcs      Number of arcs to regular ports kept out of each vertex
+         * @param already_erased    List of edges which have already been removed
+         * @param pool              If not null, the vertices are processed in parallel on this pool
          * @return                  List of all edges to remove
          */
-        ErasedEdges smart_reduce_graph(double min_chance, double max_chance, ErasedEdges already_erased) const;
+        ErasedEdges sparsify_graph(unsigned int max_out_arcs, ErasedEdges already_erased, TaskPool* pool = nullptr) const;
 
         /**
          * Gives the maximum dual prize that can be collected at any port.
@@ -7,6 +7,7 @@
 
 #include <iostream>
 #include <memory>
+#include <vector>
 
 #include "vessel_class.h"
 #include "port.h"
@@ -21,6 +22,7 @@ namespace mvrp {
     };
 
     using PortWithType = std::pair<Port*, PortType>;
+    using VisitablePorts = std::vector<std::pair<std::shared_ptr<Port>, PortType>>;
 
     struct Node {
         /**
@@ -8,7 +8,10 @@
 #include "../preprocessing/graph_generator.h"
 
 namespace mvrp {
-    Problem::Problem(const std::string &params_file, const std::string &data_file) : params{params_file}, data{data_file}, graphs{} {
+    Problem::Problem(const std::string &params_file, const std::string &data_file) : params{params_file}, data{data_file}, graphs{},
+        pricing_pool{std::make_shared<TaskPool>(params.pricing_threads)},
+        stage_scheduler{params.adaptive_pricing ? std::make_shared<StageScheduler>(params.adaptive_pricing_exploration) : nullptr},
+        vessel_class_scheduler{params.partial_pricing != PartialPricing::NONE ? std::make_shared<VesselClassScheduler>(params.partial_pricing, data.vessel_classes) : nullptr} {
         for(auto vessel_class : data.vessel_classes) {
             auto g = GraphGenerator::create_graph(data, params, vessel_class);
 
@@ -10,13 +10,16 @@
 #include <unordered_map>
 
 #include "graph.h"
+#include "task_pool.h"
 #include "vessel_class.h"
 #include "../preprocessing/problem_data.h"
 #include "../preprocessing/program_params.h"
+#include "../subproblem/stage_scheduler.h"
 
 namespace mvrp {
     using GraphMap = std::unordered_map<std::shared_ptr<VesselClass>, std::shared_ptr<Graph>>;
     using ErasedEdgesMap = std::unordered_map<std::shared_ptr<VesselClass>, ErasedEdges>;
+    using CriticalPortsMap = std::unordered_map<std::shared_ptr<VesselClass>, VisitablePorts>;
 
     struct Problem {
         /**
@@ -34,6 +37,21 @@ namespace mvrp {
          */
         GraphMap graphs;
 
+        /**
+         * Pool of threads shared by all the pricing algorithms, for the whole run.
+         */
+        std::shared_ptr<TaskPool> pricing_pool;
+
+        /**
+         * Learns the order of the pricing stages over the whole run. Null if adaptive pricing is disabled.
+         */
+        std::shared_ptr<StageScheduler> stage_scheduler;
+
+        /**
+         * Order of the vessel classes in partial pricing, over the whole run. Null if partial pricing is disabled.
+         */
+        std::shared_ptr<VesselClassScheduler> vessel_class_scheduler;
+
         Problem(const std::string &params_file, const std::string &data_file);
     };
 }
@@ -0,0 +1,88 @@
+//  Created by Alberto Santini on 18/09/13.
+//  Copyright (c) 2013 Alberto Santini. All rights reserved.
+//
+
+#include "task_pool.h"
+
+namespace mvrp {
+    TaskPool::TaskPool(unsigned int n_threads) :
+        stopping{false}, created{Clock::now()}, tasks_run{0u}, busy_nanoseconds{0u}, parallel_for_calls{0u},
+        parallel_for_iterations{0u}, peak_queue_length{0u}
+    {
+        for(auto i = 0u; i < n_threads; i++) {
+            workers.push_back(std::thread([this] () { work(); }));
+        }
+    }
+
+    TaskPool::~TaskPool() {
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            stopping = true;
+        }
+
+        cv.notify_all();
+
+        for(auto& w : workers) { w.join(); }
+    }
+
+    void TaskPool::submit(std::function<void()> task) {
+        if(workers.empty()) {
+            task();
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            tasks.push_back(std::move(task));
+            peak_queue_length = std::max(peak_queue_length, tasks.size());
+        }
+
+        cv.notify_one();
+    }
+
+    void TaskPool::work() {
+        while(true) {
+            std::function<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [this] () { return stopping || !tasks.empty(); });
+
+                if(tasks.empty()) { return; }
+
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+
+            auto start = Clock::now();
+            task();
+            busy_nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+            ++tasks_run;
+        }
+    }
+
+    TaskPoolStats TaskPool::stats() {
+        TaskPoolStats s;
+
+        s.n_workers = size();
+        s.tasks_run = tasks_run.load();
+        s.parallel_for_calls = parallel_for_calls.load();
+        s.parallel_for_iterations = parallel_for_iterations.load();
+        s.busy_time = busy_nanoseconds.load() / 1e9;
+        s.uptime = std::chrono::duration<double>(Clock::now() - created).count();
+
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            s.peak_queue_length = peak_queue_length;
+        }
+
+        return s;
+    }
+
+    std::ostream& operator<<(std::ostream& out, const TaskPoolStats& s) {
+        out << s.n_workers << " workers, " << s.tasks_run << " tasks run, " << s.parallel_for_calls << " parallel loops over "
+            << s.parallel_for_iterations << " indices, " << s.peak_queue_length << " peak queue length, "
+            << s.busy_time << "s busy over " << s.uptime << "s (" << 100.0 * s.utilization() << "% utilization)";
+        return out;
+    }
+}
@@ -0,0 +1,167 @@
+//  Created by Alberto Santini on 18/09/13.
+//  Copyright (c) 2013 Alberto Santini. All rights reserved.
+//
+
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mvrp {
+    /**
+     * Utilization statistics of a task pool, since its creation.
+     */
+    struct TaskPoolStats {
+        unsigned int n_workers;
+
+        /* Tasks run by the workers */
+        std::uint64_t tasks_run;
+
+        /* Calls to parallel_for and total number of indices they processed */
+        std::uint64_t parallel_for_calls;
+        std::uint64_t parallel_for_iterations;
+
+        /* Largest number of tasks waiting in the queue */
+        std::size_t peak_queue_length;
+
+        /* Time spent by all workers running tasks, and time since the pool was created (s) */
+        double busy_time;
+        double uptime;
+
+        /**
+         * Share of the workers' time spent running tasks.
+         */
+        double utilization() const { return (n_workers > 0u && uptime > 0.0) ? busy_time / (uptime * n_workers) : 0.0; }
+    };
+
+    std::ostream& operator<<(std::ostream& out, const TaskPoolStats& s);
+
+    class TaskPool {
+        using Clock = std::chrono::steady_clock;
+
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> tasks;
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool stopping;
+
+        Clock::time_point created;
+        std::atomic<std::uint64_t> tasks_run;
+        std::atomic<std::uint64_t> busy_nanoseconds;
+        std::atomic<std::uint64_t> parallel_for_calls;
+        std::atomic<std::uint64_t> parallel_for_iterations;
+        std::size_t peak_queue_length;
+
+        void work();
+
+    public:
+        /**
+         * Creates a pool with a certain number of worker threads. With 0 workers,
+         * everything is run sequentially by the calling thread.
+         * @param n_threads Number of worker threads
+         */
+        explicit TaskPool(unsigned int n_threads);
+        ~TaskPool();
+
+        TaskPool(const TaskPool&) = delete;
+        TaskPool& operator=(const TaskPool&) = delete;
+
+        /**
+         * Gives the number of worker threads.
+         */
+        unsigned int size() const { return workers.size(); }
+
+        /**
+         * Gives the utilization statistics of the pool.
+         */
+        TaskPoolStats stats();
+
+        /**
+         * Queues a task, which will be run by the first idle worker.
+         * @param task  The task to run
+         */
+        void submit(std::function<void()> task);
+
+        /**
+         * Calls f(0), ..., f(n - 1) in parallel and returns when all calls are done.
+         * Idle workers grab the next index as soon as they finish the previous one; the
+         * calling thread takes part in the work too, so that it is safe to call this
+         * method from inside another task of the same pool. The first exception thrown
+         * by any call is re-thrown to the caller.
+         * @param n     Number of calls
+         * @param f     The function to call
+         */
+        template<typename F>
+        void parallel_for(std::size_t n, F&& f);
+    };
+
+    template<typename F>
+    void TaskPool::parallel_for(std::size_t n, F&& f) {
+        ++parallel_for_calls;
+        parallel_for_iterations += n;
+
+        if(workers.empty() || n <= 1u) {
+            for(auto i = 0u; i < n; i++) { f(i); }
+            return;
+        }
+
+        struct State {
+            std::atomic<std::size_t> next{0u};
+            std::size_t done{0u};
+            std::exception_ptr error;
+            std::mutex mtx;
+            std::condition_variable cv;
+        };
+
+        auto state = std::make_shared<State>();
+        auto fp = &f;
+
+        // Claims indices until there are none left. After the last index has been claimed,
+        // f might go out of scope: late helpers must not touch it.
+        auto run = [state, fp, n] () {
+            std::size_t i, local_done = 0u;
+            std::exception_ptr local_error;
+
+            while((i = state->next.fetch_add(1u)) < n) {
+                try {
+                    (*fp)(i);
+                } catch(...) {
+                    if(!local_error) { local_error = std::current_exception(); }
+                }
+                ++local_done;
+            }
+
+            if(local_done == 0u) { return; }
+
+            std::lock_guard<std::mutex> guard(state->mtx);
+            if(local_error && !state->error) { state->error = local_error; }
+            state->done += local_done;
+            if(state->done == n) { state->cv.notify_all(); }
+        };
+
+        auto n_helpers = std::min<std::size_t>(workers.size(), n - 1u);
+        for(auto i = 0u; i < n_helpers; i++) { submit(run); }
+
+        run();
+
+        std::unique_lock<std::mutex> lock(state->mtx);
+        state->cv.wait(lock, [&state, n] () { return state->done == n; });
+
+        if(state->error) { std::rethrow_exception(state->error); }
+    }
+}
+
+#endif
@@ -0,0 +1,62 @@
+//  Created by Alberto Santini on 18/09/13.
+//  Copyright (c) 2013 Alberto Santini. All rights reserved.
+//
+
+#ifndef TASK_RNG_H
+#define TASK_RNG_H
+
+#include <cstdint>
+#include <limits>
+
+namespace mvrp {
+    /**
+     * Counter-based random number generator. The i-th number of a stream only depends on the
+     * stream's key and on i, and the key is built from the run seed and from the coordinates of
+     * the task using it (B&B node, vessel class, task index). Therefore, tasks can run in any order
+     * and on any thread, and still draw the same numbers.
+     */
+    class TaskRng {
+        std::uint64_t key;
+        std::uint64_t counter;
+
+        /* Finaliser of SplitMix64: a bijection on 64-bit integers, with good avalanche */
+        static constexpr std::uint64_t mix(std::uint64_t z) {
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+
+        static constexpr std::uint64_t combine(std::uint64_t k, std::uint64_t v) {
+            return mix(k ^ (v + 0x9e3779b97f4a7c15ull));
+        }
+
+    public:
+        using result_type = std::uint64_t;
+
+        /**
+         * @param seed          Seed of the run
+         * @param node          Number of the B&B node
+         * @param vessel_class  Index of the vessel class
+         * @param task          Index of the task within the node and vessel class (e.g. the rerun of a heuristic)
+         */
+        TaskRng(std::uint64_t seed, std::uint64_t node, std::uint64_t vessel_class, std::uint64_t task) :
+                key{combine(combine(combine(mix(seed), node), vessel_class), task)}, counter{0u} {}
+
+        static constexpr result_type min() { return 0u; }
+        static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+        result_type operator()() { return mix(key + 0x9e3779b97f4a7c15ull * ++counter); }
+
+        /**
+         * Gives an integer uniformly distributed in [0, n), n > 0.
+         */
+        std::uint64_t below(std::uint64_t n) { return (*this)() % n; }
+
+        /**
+         * Gives a double uniformly distributed in [0, 1).
+         */
+        double uniform() { return ((*this)() >> 11) * (1.0 / 9007199254740992.0); }
+    };
+}
+
+#endif
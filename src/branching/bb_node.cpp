@@ -5,16 +5,25 @@
 #include "bb_node.h"
 
 #include <algorithm>
+#include <cmath>
 #include <limits>
 #include <numeric>
 #include <iomanip>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <boost/functional/hash.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
 
 namespace mvrp {
     BBNode::BBNode( std::shared_ptr<const Problem> prob,
                     const ErasedEdgesMap& local_erased_edges,
                     std::vector<PortWithType> ports_with_equality,
                     std::shared_ptr<ColumnPool> pool,
+                    std::shared_ptr<SolutionIndex> pool_index,
                     const ColumnPool &local_pool,
                     std::shared_ptr<BranchingRule> branching_rule,
                     boost::optional<double> father_lb,
@@ -32,6 +41,7 @@ namespace mvrp {
                    ports_with_equality(ports_with_equality),
                    pool(pool),
                    local_pool(local_pool),
+                   pool_index(pool_index),
                    branching_rule(branching_rule),
                    father_lb(father_lb),
                    depth(depth),
@@ -46,17 +56,22 @@ namespace mvrp {
         sol_value = std::numeric_limits<double>::max();
         mip_sol_value = std::numeric_limits<double>::max();
         all_times_spent_on_sp = std::vector<double>(0);
+        for(const auto& vc : prob->data.vessel_classes) { critical_ports[vc] = VisitablePorts(); }
         make_local_erased_edges();
         remove_incompatible_columns();
         determine_equality_constraints();
+        local_index = SolutionIndex(this->local_pool);
     }
 
     BBNode::BBNode(const BBNode& father, std::shared_ptr<BranchingRule> branching_rule, std::string name) :
         prob{father.prob},
         local_erased_edges{father.local_erased_edges},
         ports_with_equality{father.ports_with_equality},
+        critical_ports{father.critical_ports},
         pool{father.pool},
         local_pool{father.local_pool},
+        local_pool_ages{father.local_pool_ages},
+        pool_index{father.pool_index},
         branching_rule{branching_rule},
         father_lb{father.sol_value},
         depth{father.depth + 1},
@@ -68,6 +83,7 @@ namespace mvrp {
         make_local_erased_edges();
         remove_incompatible_columns();
         determine_equality_constraints();
+        local_index = SolutionIndex(local_pool);
     }
 
     void BBNode::make_local_erased_edges() {
@@ -81,13 +97,18 @@ namespace mvrp {
     void BBNode::remove_incompatible_columns() {
         if(!branching_rule) { return; }
 
+        local_pool_ages.resize(local_pool.size(), 0u);
+
         ColumnPool new_local_pool;
-        for(const auto& c : local_pool) {
-            if(branching_rule->is_column_compatible(c)) {
-                new_local_pool.push_back(c);
+        std::vector<unsigned int> new_local_pool_ages;
+        for(auto i = 0u; i < local_pool.size(); i++) {
+            if(branching_rule->is_column_compatible(local_pool[i])) {
+                new_local_pool.push_back(local_pool[i]);
+                new_local_pool_ages.push_back(local_pool_ages[i]);
             }
         }
         local_pool = new_local_pool;
+        local_pool_ages = new_local_pool_ages;
     }
 
     void BBNode::determine_equality_constraints() {
@@ -125,30 +146,46 @@ namespace mvrp {
     void BBNode::remove_duplicate_columns() {
         ColumnPool new_pool;
 
+        // Position in new_pool of the column with each vector of constraint coefficients
+        std::unordered_map<std::vector<int>, std::size_t, boost::hash<std::vector<int>>> position;
+
         for(const auto &c : *pool) {
-            auto nc = std::find_if(new_pool.begin(), new_pool.end(),
-                                   [&](const Column &c_in_new_pool) {
-                                       return column_coefficients(c) == column_coefficients(c_in_new_pool);
-                                   });
+            auto nc = position.emplace(column_coefficients(c), new_pool.size());
 
-            if(nc == new_pool.end()) { new_pool.push_back(c); }
-            else if(nc->obj_coeff > c.obj_coeff) { *nc = c; }
+            if(nc.second) { new_pool.push_back(c); }
+            else if(new_pool[nc.first->second].obj_coeff > c.obj_coeff) { new_pool[nc.first->second] = c; }
         }
 
         std::cerr << "\tRemoved " << pool->size() - new_pool.size() << " duplicate columns"
                   << " out of " << pool->size() << std::endl;
 
         *pool = new_pool;
+        *pool_index = SolutionIndex(*pool);
     }
 
-    void BBNode::solve(unsigned int node_number) {
+    void BBNode::solve(unsigned int node_number, const CancellationToken &cancellation, double ub) {
         using namespace std::chrono;
 
         auto node_start = high_resolution_clock::now();
 
+        // If early branching is enabled and we are not at the root node, pricing also stops at the early branching timeout
+        auto node_cancellation = (prob->params.early_branching && father_lb) ?
+                                 cancellation.with_deadline(prob->params.early_branching_timeout) :
+                                 cancellation;
+
         // Clear any eventual previous solutions
         base_columns = std::vector<std::pair<Column, double>>();
         sol_value = 0;
+        lagrangian_bound = boost::none;
+        recent_lp_values.clear();
+        recent_lagrangian_bounds.clear();
+        stability_centre = boost::none;
+
+        // Dual smoothing is enabled
+        auto smoothing = prob->params.dual_smoothing_alpha > 0.0;
+
+        // Column aging is enabled
+        auto aging = prob->params.column_max_age > 0u || prob->params.max_local_pool_size > 0u;
 
         auto mp_solv = MPSolver(prob);
 
@@ -163,44 +200,103 @@ namespace mvrp {
         std::cerr << std::unitbuf << "\tMP: " << std::setprecision(std::numeric_limits<double>::max_digits10)
                   << sol.obj_value << " in " << std::setprecision(2) << mp_time << " seconds" << std::endl;
 
+        // Remember we only even try with elemntary labelling every n nodes
+        if(prob->params.elementary_labelling_every_n_nodes == 0 ||
+           node_number % prob->params.elementary_labelling_every_n_nodes != 0) { try_elementary = false; }
+
+        if(prob->params.asynchronous_column_generation) {
+            sol = solve_async(mp_solv, sol, node_number, node_cancellation);
+        }
+
         auto node_explored = false;
 
         // Keep going until we can prove the node has been explored!
         while(!node_explored) {
-            // Update dual values (and save the old port duals)
-            for(const auto &vg : prob->graphs) {
-                vg.second->graph[boost::graph_bundle].old_port_duals = vg.second->graph[boost::graph_bundle].port_duals;
-                vg.second->graph[boost::graph_bundle].port_duals = sol.port_duals;
-                vg.second->graph[boost::graph_bundle].vc_dual = sol.vc_duals.at(vg.first);
-            }
+            // The routes in the current LP solution are the starting points of the local search
+            auto base_routes = lp_routes(sol);
 
-            auto sp_solv = SPSolver(prob, local_erased_edges);
+            // Solve the pricing subproblem at the given duals
+            auto price = [&] (const Duals &duals) {
+                // Update dual values (and save the old port duals)
+                update_duals(duals);
+
+                auto min_reduced_costs = MinReducedCosts();
+                auto sp_solv = SPSolver(prob, local_erased_edges, critical_ports, &labelling_stats, node_number, &min_reduced_costs);
+
+                auto sp_start = high_resolution_clock::now();
+                auto found = sp_solv.solve(local_pool, local_index, pool, pool_index, base_routes, try_elementary, max_time_spent_by_exact_solver, node_cancellation);
+                auto sp_end = high_resolution_clock::now();
+
+                auto sp_time = duration_cast<duration<double>>(sp_end - sp_start).count();
+                total_time_spent_on_sp += sp_time;
+                all_times_spent_on_sp.push_back(sp_time);
+
+                std::cerr << std::unitbuf << "\t\tSP found " << found.first << " columns in "
+                          << std::setprecision(2) << sp_time << " seconds" << std::endl;
+
+                // With Wentges smoothing, the stability centre follows the best Lagrangian bound
+                if(update_lagrangian_bound(duals, min_reduced_costs) && smoothing && !prob->params.dual_smoothing_in_out) { stability_centre = duals; }
+
+                return found;
+            };
+
+            auto lp_duals = Duals(sol);
             auto sp_found_columns = 0;
             auto orig = ColumnOrigin::NONE;
 
-            // Remember we only even try with elemntary labelling every n nodes
-            if(prob->params.elementary_labelling_every_n_nodes == 0 ||
-               node_number % prob->params.elementary_labelling_every_n_nodes != 0) { try_elementary = false; }
+            if(smoothing && stability_centre) {
+                auto duals = smoothed_duals(lp_duals);
+                std::tie(sp_found_columns, orig) = price(duals);
+
+                // The LP duals are what we have to prove optimal: if the smoothed ones did not give any column which
+                // improves the LP, price again at the LP duals
+                if(!node_cancellation.is_cancelled() && mispriced(lp_duals, sp_found_columns)) {
+                    std::cerr << "\t\tMis-pricing: pricing again at the LP duals" << std::endl;
+
+                    auto more_columns = 0;
+                    auto more_orig = ColumnOrigin::NONE;
+                    std::tie(more_columns, more_orig) = price(lp_duals);
+
+                    if(more_columns == 0 && !node_cancellation.is_cancelled()) {
+                        // The columns priced at the smoothed duals cannot improve the LP, and there are no others:
+                        // the LP duals are optimal
+                        sp_found_columns = 0;
+                        orig = ColumnOrigin::NONE;
+                    } else if(more_columns > 0) {
+                        // Only the columns priced at the LP duals improve the LP
+                        sp_found_columns += more_columns;
+                        orig = more_orig;
+                    }
 
-            // Solve the pricing subproblem
-            auto sp_start = high_resolution_clock::now();
-            std::tie(sp_found_columns, orig) = sp_solv.solve(local_pool, pool, try_elementary, max_time_spent_by_exact_solver);
-            auto sp_end = high_resolution_clock::now();
+                    duals = lp_duals;
+                }
 
-            auto sp_time = duration_cast<duration<double>>(sp_end - sp_start).count();
-            total_time_spent_on_sp += sp_time;
-            all_times_spent_on_sp.push_back(sp_time);
+                if(prob->params.dual_smoothing_in_out || !lagrangian_bound) { stability_centre = duals; }
+            } else {
+                std::tie(sp_found_columns, orig) = price(lp_duals);
+                if(smoothing && (prob->params.dual_smoothing_in_out || !lagrangian_bound)) { stability_centre = lp_duals; }
+            }
 
-            std::cerr << std::unitbuf << "\t\tSP found " << sp_found_columns << " columns in "
-                      << std::setprecision(2) << sp_time << " seconds" << std::endl;
+            if(sp_found_columns > 0 && lagrangian_bound && *lagrangian_bound >= ub) {
+                // No solution at this node can beat the incumbent: the B&B tree will prune the node
+                node_explored = true;
+                sol_value = *lagrangian_bound;
 
-            // If new [negative reduced cost] columns are found, solve the LP again
-            if(sp_found_columns > 0) {
+                std::cerr << "Lagrangian bound over the UB: stopping the exploration of this node." << std::endl;
+            } else if(sp_found_columns > 0) {
+                // If new [negative reduced cost] columns are found, solve the LP again
                 // If:  we are currently trying elementary labelling AND
                 //      at last iteration we tried elementary labelling AND
                 //      it didn't produce any result
                 // Then: stop trying elementary labelling
-                if(try_elementary && (orig != ColumnOrigin::FAST_H) && (orig != ColumnOrigin::ESPPRC)) { try_elementary = false; }
+                // The stage scheduler, if any, decides by itself when the elementary labelling is worth trying.
+                if(!prob->stage_scheduler && try_elementary && (orig != ColumnOrigin::POOL) && (orig != ColumnOrigin::LOCAL_SEARCH) && (orig != ColumnOrigin::FAST_H) && (orig != ColumnOrigin::ESPPRC)) { try_elementary = false; }
+
+                // Age the columns with the LP solution the duals come from, and remove the old ones from the LP
+                if(aging) {
+                    age_columns(sol);
+                    mp_solv.remove_columns(purge_columns());
+                }
 
                 // Re-solve the LP
                 auto mp_start = high_resolution_clock::now();
@@ -209,17 +305,20 @@ namespace mvrp {
 
                 total_time_spent_on_mp += duration_cast<duration<double>>(mp_end - mp_start).count();
 
-                // If early branching is enabled and we are not at the root node
-                if(prob->params.early_branching && father_lb) {
-                    auto time_at_node = duration_cast<duration<double>>(mp_end - node_start).count();
+                auto time_at_node = duration_cast<duration<double>>(mp_end - node_start).count();
+                auto over_time = prob->params.early_branching && time_at_node > prob->params.early_branching_timeout;
+                auto tailed_off = tailing_off(sol.obj_value);
 
-                    // If it took too long to explore this node, perform early branching
-                    if(time_at_node > prob->params.early_branching_timeout) {
+                // If we are not at the root node
+                if(father_lb) {
+                    // If early branching is enabled and it took too long to explore this node,
+                    // or if column generation is tailing off, perform early branching
+                    if(over_time || tailed_off) {
                         // Mark the node as explored (even if, technically, it is not)
                         node_explored = true;
 
-                        // We can't say anything on the LB at this node, so we have to carry the father's LB
-                        sol_value = *father_lb;
+                        // The LB at this node is the father's LB, or the Lagrangian bound if it is better
+                        sol_value = lagrangian_bound ? std::max(*father_lb, *lagrangian_bound) : *father_lb;
 
                         // We use the last solution to the LP as the solution to this node
                         for(auto i = 0u; i < sol.variables.size(); i++) {
@@ -228,9 +327,9 @@ namespace mvrp {
                             }
                         }
 
-                        std::cerr << "Over early branching time limit: stopping the exploration of this node."
-                                  << std::endl;
-                        std::cerr << "Performing early branching with LB = Father's LB = "
+                        std::cerr << (over_time ? "Over early branching time limit" : "Column generation tailing off")
+                                  << ": stopping the exploration of this node." << std::endl;
+                        std::cerr << "Performing early branching with LB = "
                                   << std::setprecision(std::numeric_limits<double>::max_digits10) << sol_value
                                   << std::endl;
                     }
@@ -238,6 +337,23 @@ namespace mvrp {
 
                 std::cerr << std::unitbuf << "\tMP: " << std::setprecision(std::numeric_limits<double>::max_digits10)
                           << sol.obj_value << std::endl;
+            } else if(node_cancellation.is_cancelled()) {
+                // Pricing was interrupted, so we could not prove that there are no more negative reduced cost columns
+                node_explored = true;
+
+                // The LB at this node is the father's LB, or the Lagrangian bound if it is better. The value of
+                // the last LP is not a LB, as pricing did not finish: without any of them, the LB is unknown.
+                sol_value = father_lb ? *father_lb : std::numeric_limits<double>::lowest();
+                if(lagrangian_bound) { sol_value = std::max(sol_value, *lagrangian_bound); }
+
+                // We use the last solution to the LP as the solution to this node
+                for(auto i = 0u; i < sol.variables.size(); i++) {
+                    if(sol.variables[i] > BBNode::cplex_epsilon) {
+                        base_columns.push_back(std::make_pair(local_pool[i], sol.variables[i]));
+                    }
+                }
+
+                std::cerr << "Pricing interrupted: stopping the exploration of this node." << std::endl;
             } else {
                 // If no negative reduced cost column was found, the node is explored
                 node_explored = true;
@@ -263,10 +379,322 @@ namespace mvrp {
 
         std::cerr << "Node explored in " << std::setprecision(2) << total_time_spent << " seconds" << std::endl;
 
+        // The children inherit the local pool: purge it with the last LP solution
+        if(aging) {
+            age_columns(sol);
+            purge_columns();
+        }
+
         // Remove any duplicate column we might have generated at this node
         remove_duplicate_columns();
     }
 
+    void BBNode::age_columns(const MPLinearSolution &sol) {
+        auto duals = Duals(sol);
+
+        local_pool_ages.resize(local_pool.size(), 0u);
+
+        for(auto i = 0u; i < sol.variables.size(); i++) {
+            if(sol.variables[i] > BBNode::cplex_epsilon || reduced_cost(local_pool[i], duals) <= prob->params.column_aging_rc_threshold) {
+                local_pool_ages[i] = 0u;
+            } else {
+                local_pool_ages[i]++;
+            }
+        }
+    }
+
+    std::vector<bool> BBNode::purge_columns() {
+        auto max_age = prob->params.column_max_age;
+        auto max_size = prob->params.max_local_pool_size;
+        auto purged = std::vector<bool>(local_pool.size(), false);
+        auto n_purged = 0u;
+        auto candidates = std::vector<std::size_t>();
+
+        local_pool_ages.resize(local_pool.size(), 0u);
+
+        for(auto i = 0u; i < local_pool.size(); i++) {
+            if(local_pool[i].dummy || local_pool_ages[i] == 0u) { continue; }
+
+            if(max_age > 0u && local_pool_ages[i] >= max_age) {
+                purged[i] = true;
+                n_purged++;
+            } else {
+                candidates.push_back(i);
+            }
+        }
+
+        if(max_size > 0u && local_pool.size() - n_purged > max_size) {
+            std::stable_sort(candidates.begin(), candidates.end(),
+                             [&](std::size_t i, std::size_t j) { return local_pool_ages[i] > local_pool_ages[j]; });
+
+            for(auto i : candidates) {
+                if(local_pool.size() - n_purged <= max_size) { break; }
+                purged[i] = true;
+                n_purged++;
+            }
+        }
+
+        if(n_purged == 0u) { return purged; }
+
+        ColumnPool new_local_pool;
+        std::vector<unsigned int> new_local_pool_ages;
+        for(auto i = 0u; i < local_pool.size(); i++) {
+            if(purged[i]) {
+                // The column can still be priced back from the global pool
+                if(pool_index->insert(local_pool[i].sol)) { pool->push_back(local_pool[i]); }
+            } else {
+                new_local_pool.push_back(local_pool[i]);
+                new_local_pool_ages.push_back(local_pool_ages[i]);
+            }
+        }
+        local_pool = new_local_pool;
+        local_pool_ages = new_local_pool_ages;
+        local_index = SolutionIndex(local_pool);
+
+        std::cerr << std::unitbuf << "\t\tPurged " << n_purged << " columns from the local pool, which now has "
+                  << local_pool.size() << " columns" << std::endl;
+
+        return purged;
+    }
+
+    BBNode::Duals BBNode::smoothed_duals(const Duals &lp_duals) const {
+        assert(stability_centre);
+
+        auto alpha = prob->params.dual_smoothing_alpha;
+        auto duals = lp_duals;
+
+        for(auto &pd : duals.port_duals) {
+            const auto &centre = stability_centre->port_duals.at(pd.first);
+            pd.second.first = alpha * centre.first + (1 - alpha) * pd.second.first;
+            pd.second.second = alpha * centre.second + (1 - alpha) * pd.second.second;
+        }
+
+        for(auto &vd : duals.vc_duals) {
+            vd.second = alpha * stability_centre->vc_duals.at(vd.first) + (1 - alpha) * vd.second;
+        }
+
+        return duals;
+    }
+
+    double BBNode::reduced_cost(const Column &col, const Duals &duals) const {
+        auto np = prob->data.num_ports;
+        auto nv = prob->data.num_vessel_classes;
+        auto rc = col.obj_coeff;
+
+        for(auto i = 1; i < np; i++) {
+            const auto &pd = duals.port_duals.at(prob->data.ports[i]);
+            rc -= col.port_coeff[i - 1] * pd.first;
+            rc -= col.port_coeff[np - 1 + i - 1] * pd.second;
+        }
+        for(auto i = 0; i < nv; i++) {
+            rc -= col.vc_coeff[i] * duals.vc_duals.at(prob->data.vessel_classes[i]);
+        }
+
+        return rc;
+    }
+
+    bool BBNode::mispriced(const Duals &lp_duals, int n_found) const {
+        assert(n_found >= 0 && (std::size_t) n_found <= local_pool.size());
+
+        return std::none_of(local_pool.end() - n_found, local_pool.end(),
+                            [&](const Column &col) { return reduced_cost(col, lp_duals) < -EPS; });
+    }
+
+    void BBNode::update_duals(const Duals &duals) {
+        for(const auto &vg : prob->graphs) {
+            vg.second->graph[boost::graph_bundle].old_port_duals = vg.second->graph[boost::graph_bundle].port_duals;
+            vg.second->graph[boost::graph_bundle].port_duals = duals.port_duals;
+            vg.second->graph[boost::graph_bundle].vc_dual = duals.vc_duals.at(vg.first);
+        }
+    }
+
+    bool BBNode::update_lagrangian_bound(const Duals &duals, const MinReducedCosts &min_reduced_costs) {
+        // The dual function at these duals: the objective of the master problem, with its rows relaxed
+        auto bound = 0.0;
+
+        for(const auto &p : prob->data.ports) {
+            bound += p->pickup_penalty + p->delivery_penalty;
+        }
+        for(const auto &pd : duals.port_duals) {
+            bound += pd.second.first + pd.second.second;
+        }
+        for(const auto &vc : prob->data.vessel_classes) {
+            auto it = min_reduced_costs.find(vc);
+            if(it == min_reduced_costs.end()) { return false; }
+            bound += vc->num_vessels * (duals.vc_duals.at(vc) + it->second);
+        }
+
+        if(!lagrangian_bound || bound > *lagrangian_bound) {
+            lagrangian_bound = bound;
+            std::cerr << std::unitbuf << "\t\tLagrangian bound: " << std::setprecision(std::numeric_limits<double>::max_digits10) << bound << std::endl;
+            return true;
+        }
+
+        return false;
+    }
+
+    bool BBNode::tailing_off(double lp_value) {
+        auto window = prob->params.tailing_off_window;
+
+        if(window == 0u) { return false; }
+
+        recent_lp_values.push_back(lp_value);
+        recent_lagrangian_bounds.push_back(lagrangian_bound);
+
+        if(recent_lp_values.size() <= window) { return false; }
+
+        recent_lp_values.pop_front();
+        recent_lagrangian_bounds.pop_front();
+
+        // The LP value goes down and the Lagrangian bound goes up as column generation progresses
+        auto lp_improvement = (recent_lp_values.front() - recent_lp_values.back()) / std::max(std::abs(recent_lp_values.front()), EPS);
+        if(lp_improvement >= prob->params.tailing_off_threshold) { return false; }
+
+        const auto &first_bound = recent_lagrangian_bounds.front();
+        const auto &last_bound = recent_lagrangian_bounds.back();
+
+        if(last_bound) {
+            if(!first_bound) { return false; }
+
+            auto bound_improvement = (*last_bound - *first_bound) / std::max(std::abs(*first_bound), EPS);
+            if(bound_improvement >= prob->params.tailing_off_threshold) { return false; }
+        }
+
+        return true;
+    }
+
+    std::vector<Solution> BBNode::lp_routes(const MPLinearSolution &sol) const {
+        auto routes = std::vector<Solution>();
+
+        for(auto i = 0u; i < sol.variables.size(); i++) {
+            if(sol.variables[i] > BBNode::cplex_epsilon && !local_pool[i].dummy) { routes.push_back(local_pool[i].sol); }
+        }
+
+        return routes;
+    }
+
+    MPLinearSolution BBNode::solve_async(MPSolver &mp_solv, MPLinearSolution sol, unsigned int node_number, const CancellationToken &cancellation) {
+        using namespace std::chrono;
+
+        // Duals published by the master, with the routes of the LP solution they come from
+        struct Snapshot {
+            unsigned int version;
+            MPLinearSolution sol;
+            std::vector<Solution> base_routes;
+        };
+
+        auto latest = std::make_shared<const Snapshot>(Snapshot{1u, sol, lp_routes(sol)});
+        auto pricing_done = false;
+        auto async_cancellation = cancellation.child();
+        boost::lockfree::spsc_queue<Column> queue(async_queue_capacity);
+        std::mutex mtx;
+        std::condition_variable cv;
+
+        // Until it is joined, only the pricing thread uses the graphs, the global pool and the pricing state of
+        // the node; the master only uses the local pool, which the pricing thread never reads.
+        std::thread pricing([&] {
+            auto index = local_index;
+            auto priced_version = 0u;
+
+            while(!async_cancellation.is_cancelled()) {
+                std::shared_ptr<const Snapshot> snapshot;
+
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    cv.wait_for(lock, milliseconds(10), [&] { return latest->version > priced_version; });
+                    snapshot = latest;
+                }
+
+                if(snapshot->version == priced_version) { continue; }
+                priced_version = snapshot->version;
+
+                auto duals = Duals(snapshot->sol);
+                update_duals(duals);
+
+                auto min_reduced_costs = MinReducedCosts();
+                auto sp_solv = SPSolver(prob, local_erased_edges, critical_ports, &labelling_stats, node_number, &min_reduced_costs);
+                auto found = ColumnPool();
+                auto orig = ColumnOrigin::NONE;
+
+                auto sp_start = high_resolution_clock::now();
+                std::tie(std::ignore, orig) = sp_solv.solve(found, index, pool, pool_index, snapshot->base_routes, try_elementary, max_time_spent_by_exact_solver, async_cancellation);
+                auto sp_end = high_resolution_clock::now();
+
+                auto sp_time = duration_cast<duration<double>>(sp_end - sp_start).count();
+                total_time_spent_on_sp += sp_time;
+                all_times_spent_on_sp.push_back(sp_time);
+
+                std::cerr << std::unitbuf << "\t\tSP found " << found.size() << " columns in "
+                          << std::setprecision(2) << sp_time << " seconds (async)" << std::endl;
+
+                // Only the pricing thread uses the Lagrangian bound until it is joined
+                update_lagrangian_bound(duals, min_reduced_costs);
+
+                if(!prob->stage_scheduler && !found.empty() && try_elementary && (orig != ColumnOrigin::POOL) && (orig != ColumnOrigin::LOCAL_SEARCH) && (orig != ColumnOrigin::FAST_H) && (orig != ColumnOrigin::ESPPRC)) { try_elementary = false; }
+
+                for(const auto &col : found) {
+                    while(!queue.push(col) && !async_cancellation.is_cancelled()) { std::this_thread::yield(); }
+                }
+
+                std::lock_guard<std::mutex> guard(mtx);
+
+                // Nothing more to find until the master publishes new duals, which it only does when it gets new columns
+                if(found.empty() && latest->version == priced_version) { break; }
+
+                cv.notify_all();
+            }
+
+            std::lock_guard<std::mutex> guard(mtx);
+            pricing_done = true;
+            cv.notify_all();
+        });
+
+        auto drain = [&] {
+            return queue.consume_all([&] (const Column &col) {
+                local_pool.push_back(col);
+                local_index.insert(col.sol);
+            });
+        };
+
+        auto resolve = [&] (std::size_t batch) {
+            auto mp_start = high_resolution_clock::now();
+            sol = mp_solv.solve_lp(local_pool, ports_with_equality);
+            auto mp_end = high_resolution_clock::now();
+
+            total_time_spent_on_mp += duration_cast<duration<double>>(mp_end - mp_start).count();
+
+            std::cerr << std::unitbuf << "\tMP: " << std::setprecision(std::numeric_limits<double>::max_digits10)
+                      << sol.obj_value << " with a batch of " << batch << " columns (async)" << std::endl;
+        };
+
+        while(!cancellation.is_cancelled()) {
+            auto batch = drain();
+
+            if(batch > 0u) {
+                resolve(batch);
+
+                auto snapshot = std::make_shared<const Snapshot>(Snapshot{latest->version + 1u, sol, lp_routes(sol)});
+
+                std::lock_guard<std::mutex> guard(mtx);
+                latest = snapshot;
+                cv.notify_all();
+            } else {
+                std::unique_lock<std::mutex> lock(mtx);
+                if(pricing_done && queue.read_available() == 0u) { break; }
+                cv.wait_for(lock, milliseconds(10), [&] { return pricing_done || queue.read_available() > 0u; });
+            }
+        }
+
+        async_cancellation.cancel();
+        pricing.join();
+
+        // Columns pushed after the last batch
+        auto batch = drain();
+        if(batch > 0u) { resolve(batch); }
+
+        return sol;
+    }
+
     bool BBNode::solve_integer(const ColumnPool &feasible_columns) {
         // Clear any eventual previous solutions
         mip_base_columns = std::vector<std::pair<Column, double>>();
@@ -5,6 +5,9 @@
 #ifndef BB_NODE_H
 #define BB_NODE_H
 
+#include <cstddef>
+#include <deque>
+#include <limits>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -13,6 +16,7 @@
 
 #include "../base/problem.h"
 #include "../column/column_pool.h"
+#include "../column/solution_index.h"
 #include "../masterproblem/mp_solver.h"
 #include "../subproblem/sp_solver.h"
 #include "../branching/branching_rule.h"
@@ -26,9 +30,20 @@ namespace mvrp {
         ErasedEdgesMap local_erased_edges;
         std::vector<PortWithType> ports_with_equality;
 
+        /* Critical ports found by the DSSR elementary labelling, inherited from the father node */
+        CriticalPortsMap critical_ports;
+
         std::shared_ptr<ColumnPool> pool;
         ColumnPool local_pool;
 
+        /* Number of consecutive LP solutions in which each column of local_pool was not used and had reduced cost
+           above column_aging_rc_threshold. Columns added after the last LP solution may have no entry yet. */
+        std::vector<unsigned int> local_pool_ages;
+
+        /* Fingerprints of the columns in pool and local_pool, to spot duplicates in constant time */
+        std::shared_ptr<SolutionIndex> pool_index;
+        SolutionIndex local_index;
+
         std::shared_ptr<BranchingRule> branching_rule;
 
         /*  The optimal columns selected by the LP solver with the coefficient */
@@ -42,6 +57,8 @@ namespace mvrp {
         double mip_sol_value;
         /*  LB of father node, used to determine the most promising nodes in the queue. The root node does not have any. */
         boost::optional<double> father_lb;
+        /*  Best Lagrangian bound found during column generation at this node, if any */
+        boost::optional<double> lagrangian_bound;
 
         /* Depth in the BB tree */
         int depth;
@@ -52,6 +69,9 @@ namespace mvrp {
         /*  Used to determine if a solution is integral, or with cost < 0 */
         static constexpr double cplex_epsilon = 0.000001;
 
+        /*  Max number of columns waiting for the master in asynchronous column generation */
+        static constexpr std::size_t async_queue_capacity = 4096u;
+
         /* Should we still try to run the ESPPRC labelling at this node? */
         bool try_elementary;
 
@@ -63,12 +83,16 @@ namespace mvrp {
         double total_time_spent;
         double max_time_spent_by_exact_solver;
 
+        /* Statistics of all the labelling runs at this node */
+        LabellingStats labelling_stats;
+
         BBNode() {}
 
         BBNode(std::shared_ptr<const Problem> prob,
                const ErasedEdgesMap &local_erased_edges,
                std::vector<PortWithType> ports_with_equality,
                std::shared_ptr<ColumnPool> pool,
+               std::shared_ptr<SolutionIndex> pool_index,
                const ColumnPool &local_pool,
                std::shared_ptr<BranchingRule> branching_rule = nullptr,
                boost::optional<double> father_lb = boost::none,
@@ -83,7 +107,11 @@ namespace mvrp {
 
         BBNode(const BBNode& father, std::shared_ptr<BranchingRule> branching_rule, std::string name);
 
-        void solve(unsigned int node_number);
+        /*  Solves the LP relaxation at this node by column generation. If the cancellation token is
+            cancelled, the node is left unexplored and its LB is the best of the father's LB and of the
+            Lagrangian bound (-inf at the root, if there is no Lagrangian bound). If the Lagrangian bound
+            reaches the UB, column generation stops and the node's LB is the Lagrangian bound */
+        void solve(unsigned int node_number, const CancellationToken &cancellation = CancellationToken(), double ub = std::numeric_limits<double>::max());
 
         bool solve_integer(const ColumnPool &feasible_columns);
 
@@ -111,7 +139,70 @@ namespace mvrp {
             function coefficients */
         std::vector<int> column_coefficients(const Column &col);
 
+        /*  Keeps, in the global pool, only the cheapest column for each vector of constraint coefficients,
+            using a hashed map from the coefficients so that it takes linear time in the pool size */
         void remove_duplicate_columns();
+
+        /*  LP values and best Lagrangian bounds of the last iterations of column generation at this node */
+        std::deque<double> recent_lp_values;
+        std::deque<boost::optional<double>> recent_lagrangian_bounds;
+
+        /*  Adds the value of the LP just solved to the recent ones, and tells whether column generation is tailing
+            off: over the last tailing_off_window iterations, neither the LP value nor, if known, the Lagrangian
+            bound improved by more than tailing_off_threshold (relative) */
+        bool tailing_off(double lp_value);
+
+        /*  Dual values of the port and vessel class rows of the master problem */
+        struct Duals {
+            PortDuals port_duals;
+            VcDuals vc_duals;
+
+            explicit Duals(const MPLinearSolution &sol) : port_duals{sol.port_duals}, vc_duals{sol.vc_duals} {}
+            Duals(PortDuals port_duals, VcDuals vc_duals) : port_duals{port_duals}, vc_duals{vc_duals} {}
+        };
+
+        /*  Stability centre of dual smoothing. With Wentges smoothing it is the point which gave the best
+            Lagrangian bound so far or, until a bound is known, the last point we priced at; with the in-out
+            variant it is always the last point we priced at. */
+        boost::optional<Duals> stability_centre;
+
+        /*  Duals at which we price: the LP duals, moved towards the stability centre by dual_smoothing_alpha */
+        Duals smoothed_duals(const Duals &lp_duals) const;
+
+        /*  Reduced cost of a column at the given duals */
+        double reduced_cost(const Column &col, const Duals &duals) const;
+
+        /*  Tells whether pricing at the smoothed duals was a mis-pricing, i.e. whether none of the last
+            n_found columns added to the local pool has negative reduced cost at the LP duals */
+        bool mispriced(const Duals &lp_duals, int n_found) const;
+
+        /*  Updates the ages of the columns in local_pool with the LP solution obtained from them */
+        void age_columns(const MPLinearSolution &sol);
+
+        /*  Moves to the global pool the columns of local_pool which reached column_max_age and then, while
+            local_pool is larger than max_local_pool_size, the oldest ones. Columns of age 0 are never purged.
+            Gives, for each column of local_pool before the purge, whether it was purged. */
+        std::vector<bool> purge_columns();
+
+        /*  Writes duals in the graphs, saving the old port duals */
+        void update_duals(const Duals &duals);
+
+        /*  Computes the Lagrangian bound given by some duals and the minimum reduced costs obtained by pricing
+            with them, if they are known for all vessel classes, and keeps it if it is the best one so far.
+            Tells whether the bound improved. */
+        bool update_lagrangian_bound(const Duals &duals, const MinReducedCosts &min_reduced_costs);
+
+        /*  Routes of the columns used by an LP solution */
+        std::vector<Solution> lp_routes(const MPLinearSolution &sol) const;
+
+        /*  Asynchronous column generation: a pricing thread keeps pricing against the latest duals, and pushes
+            the columns it finds in a queue; meanwhile, the master drains the queue in batches, solves the LP
+            again and publishes the new duals. It stops when the pricing thread finds no column with the latest
+            duals, or when the cancellation token is cancelled. It does not prove that no column with negative
+            reduced cost exists: a synchronous pass must follow. It updates the Lagrangian bound, but it neither
+            smooths the duals nor ages the columns: both only happen in the synchronous pass. Gives the last LP
+            solution. */
+        MPLinearSolution solve_async(MPSolver &mp_solv, MPLinearSolution sol, unsigned int node_number, const CancellationToken &cancellation);
     };
 
     class BBNodeCompare {
@@ -26,13 +26,14 @@ namespace mvrp {
         dummy.make_dummy(prob->params.dummy_column_price);
         pool = std::make_shared<ColumnPool>();
         pool->push_back(dummy);
+        pool_index = std::make_shared<SolutionIndex>(*pool);
 
         ErasedEdgesMap erased_edges{};
         for(auto vc : prob->data.vessel_classes) { erased_edges[vc] = ErasedEdges{}; }
 
         std::vector<PortWithType> ports_with_equality{};
 
-        auto root_node = std::make_shared<BBNode>(prob, erased_edges, ports_with_equality, pool, *pool);
+        auto root_node = std::make_shared<BBNode>(prob, erased_edges, ports_with_equality, pool, pool_index, *pool);
 
         unexplored_nodes.push(root_node);
 
@@ -69,16 +70,31 @@ namespace mvrp {
         auto node_number = 0u;
         auto start_time = high_resolution_clock::now();
 
+        // Stops the exploration when we go over the time limit, even in the middle of a node
+        auto cancellation = CancellationToken().with_deadline(prob->params.time_limit_in_s);
+
         while(!unexplored_nodes.empty()) {
             std::cerr << "Nodes in tree: " << unexplored_nodes.size() << std::endl;
 
             auto current_node = unexplored_nodes.top();
             unexplored_nodes.pop();
 
-            current_node->solve(node_number++);
+            current_node->solve(node_number++, cancellation, ub);
+
+            // The node was not completely explored, so we can't use it: keep the results obtained so far
+            if(cancellation.is_cancelled()) {
+                std::cerr << std::endl << "Over time limit, or asked to terminate, while exploring a node" << std::endl;
+                break;
+            }
+
             std::cerr << "\tNode LB: " << std::setprecision(std::numeric_limits<double>::max_digits10)
                       << current_node->sol_value << std::endl;
 
+            if(LABELLING_STATS) {
+                std::cerr << "\tLabelling: " << std::setprecision(6) << current_node->labelling_stats << std::endl;
+                if(!prob->params.labelling_stats_file.empty()) { print_labelling_stats(*current_node, node_number); }
+            }
+
             if(current_node->depth > max_depth) { max_depth = current_node->depth; }
 
             if(!current_node->is_feasible()) {
@@ -131,6 +147,9 @@ namespace mvrp {
         auto end_time = high_resolution_clock::now();
         elapsed_time = duration_cast<duration<double>>(end_time - start_time).count();
 
+        std::cerr << "Pricing pool: " << std::setprecision(4) << prob->pricing_pool->stats() << std::endl;
+        if(prob->stage_scheduler) { std::cerr << *prob->stage_scheduler; }
+
         print_summary();
         print_results();
     }
@@ -569,6 +588,22 @@ namespace mvrp {
         return os;
     }
 
+    void BBTree::print_labelling_stats(const BBNode &current_node, unsigned int node_number) const {
+        std::ofstream stats_file;
+        stats_file.open(prob->params.labelling_stats_file, std::ios::out | std::ios::app);
+
+        // Write the header if the file is new
+        if(stats_file.tellp() == 0) {
+            stats_file << "instance,node_number,node_name,depth," << LabellingStats::csv_header() << std::endl;
+        }
+
+        stats_file << instance_file_name << "," << node_number << ",\"" << current_node.name << "\"," << current_node.depth << ",";
+        current_node.labelling_stats.print_csv(stats_file);
+        stats_file << std::endl;
+
+        stats_file.close();
+    }
+
     void BBTree::print_results() const {
         std::ofstream results_file;
         results_file.open("results.txt", std::ios::out | std::ios::app);
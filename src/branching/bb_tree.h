@@ -13,6 +13,7 @@
 #include "../base/problem.h"
 #include "bb_node.h"
 #include "../column/column_pool.h"
+#include "../column/solution_index.h"
 
 namespace mvrp {
     enum class BoundType {
@@ -25,6 +26,7 @@ namespace mvrp {
     public:
         std::shared_ptr<const Problem> prob;
         std::shared_ptr<ColumnPool> pool;
+        std::shared_ptr<SolutionIndex> pool_index;
         NodeQueue unexplored_nodes;
         double ub;
         double lb;
@@ -56,6 +58,7 @@ namespace mvrp {
         void print_row(const BBNode &current_node, double gap_node) const;
         void print_summary() const;
         void print_results() const;
+        void print_labelling_stats(const BBNode &current_node, unsigned int node_number) const;
         void update_lb(std::shared_ptr<BBNode> current_node, unsigned int node_number);
     };
 }
@@ -14,7 +14,7 @@
 
 namespace mvrp {
     enum class ColumnOrigin {
-        FAST_H, ESPPRC, SPPRC_SMART, SPPRC_RED, SPPRC, MIP, NONE
+        POOL, LOCAL_SEARCH, FAST_H, ESPPRC, SPPRC_SPARSE, SPPRC_SMART, SPPRC_RED, SPPRC_BEAM, SPPRC, MIP, NONE
     };
 
     struct Column {
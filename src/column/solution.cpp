@@ -2,6 +2,7 @@
 //  Copyright (c) 2013 Alberto Santini. All rights reserved.
 //
 
+#include <algorithm>
 #include <limits>
 #include <iostream>
 
@@ -70,6 +71,23 @@ namespace mvrp {
         return true;
     }
 
+    std::uint64_t Solution::fingerprint() const {
+        // FNV-1a
+        const std::uint64_t prime = 0x100000001b3ull;
+        std::uint64_t h = 0xcbf29ce484222325ull;
+
+        auto add_byte = [&h, prime] (std::uint64_t byte) { h = (h ^ (byte & 0xffu)) * prime; };
+
+        for(const auto &c : vessel_class->name) { add_byte((unsigned char) c); }
+
+        for(const auto &e : path) {
+            auto id = (std::uint64_t) g->graph[e]->boost_edge_id;
+            for(auto i = 0u; i < 8u; i++) { add_byte(id >> (8u * i)); }
+        }
+
+        return h;
+    }
+
     double Solution::length() const {
         auto l = 0.0;
 
@@ -248,6 +266,26 @@ namespace mvrp {
         return visited;
     };
 
+    VisitablePorts Solution::repeated_ports() const {
+        VisitablePorts visited, repeated;
+
+        for(const auto& edge : path) {
+            const auto& trgn = g->graph[boost::target(edge, g->graph)];
+
+            if(trgn->n_type != NodeType::REGULAR_PORT) { continue; }
+
+            auto port = std::make_pair(trgn->port, trgn->pu_type);
+
+            if(std::find(visited.begin(), visited.end(), port) == visited.end()) {
+                visited.push_back(port);
+            } else if(std::find(repeated.begin(), repeated.end(), port) == repeated.end()) {
+                repeated.push_back(port);
+            }
+        }
+
+        return repeated;
+    }
+
     boost::optional<std::pair<PortWithType, PortWithType>> Solution::common_port_visited_from_two_different_predecessors(const Solution& other) const {
         auto this_ports = visited_ports_with_predecessors();
         auto other_ports = other.visited_ports_with_predecessors();
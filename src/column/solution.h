@@ -5,6 +5,7 @@
 #ifndef SOLUTION_H
 #define SOLUTION_H
 
+#include <cstdint>
 #include <memory>
 
 #include "../base/graph.h"
@@ -65,6 +66,9 @@ namespace mvrp {
 
         PortsWithPredecessors visited_ports_with_predecessors() const;
 
+        // Regular ports (with their pickup/delivery type) that this route visits more than once.
+        VisitablePorts repeated_ports() const;
+
         // If this route (r) and another route (s) have one port (i) in common and they visit i coming
         // from two different preceding ports (j,k) then returns the pair <j,i>.
         boost::optional<std::pair<PortWithType, PortWithType>> common_port_visited_from_two_different_predecessors(const Solution& other) const;
@@ -74,6 +78,11 @@ namespace mvrp {
         boost::optional<std::tuple<PortWithType, PortWithType, double>> common_port_succession_at_two_different_speeds(const Solution& other) const;
 
         bool operator==(const Solution &other) const;
+
+        // 64-bit hash of the vessel class and of the arcs used. It only depends on the route, so it is
+        // the same across runs; two solutions using the same arcs have the same fingerprint.
+        std::uint64_t fingerprint() const;
+
         double length() const;
         double highest_load_efficiency() const;
         uint32_t n_ports_visited() const;
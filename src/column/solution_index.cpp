@@ -0,0 +1,40 @@
+//  Created by Alberto Santini on 18/09/13.
+//  Copyright (c) 2013 Alberto Santini. All rights reserved.
+//
+
+#include "solution_index.h"
+
+namespace mvrp {
+    SolutionIndex::SolutionIndex(const ColumnPool &pool) {
+        for(const auto &c : pool) {
+            if(!c.dummy) { insert(c.sol); }
+        }
+    }
+
+    bool ConcurrentSolutionIndex::contains(const Solution &s) const {
+        auto fp = s.fingerprint();
+        auto &shard = shard_of(fp);
+
+        std::lock_guard<std::mutex> guard(shard.mtx);
+        return shard.fingerprints.find(fp) != shard.fingerprints.end();
+    }
+
+    bool ConcurrentSolutionIndex::insert(const Solution &s) {
+        auto fp = s.fingerprint();
+        auto &shard = shard_of(fp);
+
+        std::lock_guard<std::mutex> guard(shard.mtx);
+        return shard.fingerprints.insert(fp).second;
+    }
+
+    std::size_t ConcurrentSolutionIndex::size() const {
+        auto sz = 0u;
+
+        for(auto &shard : shards) {
+            std::lock_guard<std::mutex> guard(shard.mtx);
+            sz += shard.fingerprints.size();
+        }
+
+        return sz;
+    }
+}
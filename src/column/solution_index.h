@@ -0,0 +1,73 @@
+//  Created by Alberto Santini on 18/09/13.
+//  Copyright (c) 2013 Alberto Santini. All rights reserved.
+//
+
+#ifndef SOLUTION_INDEX_H
+#define SOLUTION_INDEX_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+
+#include "column_pool.h"
+#include "solution.h"
+
+namespace mvrp {
+    /**
+     * Hashed set of solution fingerprints, used to tell in constant time whether
+     * a solution is already in a column pool.
+     */
+    class SolutionIndex {
+        std::unordered_set<std::uint64_t> fingerprints;
+
+    public:
+        SolutionIndex() {}
+
+        /**
+         * Indexes all the columns of a pool, except the dummy ones.
+         */
+        explicit SolutionIndex(const ColumnPool &pool);
+
+        bool contains(const Solution &s) const { return fingerprints.find(s.fingerprint()) != fingerprints.end(); }
+
+        /**
+         * Adds a solution to the index.
+         * @return  True iff the solution was not in the index yet
+         */
+        bool insert(const Solution &s) { return fingerprints.insert(s.fingerprint()).second; }
+
+        std::size_t size() const { return fingerprints.size(); }
+    };
+
+    /**
+     * Same as SolutionIndex, but it can be used by many threads at the same time.
+     * The fingerprints are split into shards, each protected by its own mutex.
+     */
+    class ConcurrentSolutionIndex {
+        static constexpr std::size_t n_shards = 16u;
+
+        struct Shard {
+            std::mutex mtx;
+            std::unordered_set<std::uint64_t> fingerprints;
+        };
+
+        mutable std::array<Shard, n_shards> shards;
+
+        Shard &shard_of(std::uint64_t fp) const { return shards[(fp >> 56) % n_shards]; }
+
+    public:
+        bool contains(const Solution &s) const;
+
+        /**
+         * Adds a solution to the index, atomically.
+         * @return  True iff the solution was not in the index yet
+         */
+        bool insert(const Solution &s);
+
+        std::size_t size() const;
+    };
+}
+
+#endif
@@ -2,12 +2,20 @@
 //  Copyright (c) 2013 Alberto Santini. All rights reserved.
 //
 
+#include <csignal>
 #include <iostream>
 
+#include "base/cancellation.h"
 #include "branching/bb_tree.h"
 
+// On SIGTERM (e.g. at the batch scheduler's walltime) or SIGINT, stop the exploration and print the results found so far
+extern "C" void request_termination(int) {
+    mvrp::CancellationToken::request_termination();
+}
+
 int main(int argc, char* argv[]) {
-    srand(12345);
+    std::signal(SIGTERM, request_termination);
+    std::signal(SIGINT, request_termination);
     
     if(argc != 3) {
         std::cout << "Usage: ./feeder <params_file> <data_file>" << std::endl;
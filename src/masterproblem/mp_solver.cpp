@@ -2,6 +2,9 @@
 //  Copyright (c) 2013 Alberto Santini. All rights reserved.
 //
 
+#include <algorithm>
+#include <cstddef>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -9,47 +12,43 @@
 #include "mp_solver.h"
 
 namespace mvrp {
-    MPSolver::IloData MPSolver::solve(const ColumnPool &pool, const std::vector<PortWithType>& ports_with_equality, bool linear, boost::optional<std::string> model_dump) const {
-        // Calculate the sum of all penalties
-        auto all_penalties = 0.0;
-        for(const auto &p : prob->data.ports) {
-            all_penalties += p->pickup_penalty + p->delivery_penalty;
-        }
-
-        IloEnv env;
-        IloModel model(env);
-
+    std::vector<bool> MPSolver::equality_rows(const std::vector<PortWithType>& ports_with_equality) const {
         auto np = prob->data.num_ports;
-        auto nv = prob->data.num_vessel_classes;
-        std::stringstream cst_name;
-
-        IloNumVarArray var(env);
-        IloRangeArray port_constr(env, 2 * (np-1));
-        IloRangeArray vc_constr(env);
+        auto equality = std::vector<bool>(2 * (np-1), false);
 
-        IloObjective obj = IloMinimize(env, all_penalties);
-
-        // Port constraints
         for(auto i = 1; i < np; i++) {
             const auto port = prob->data.ports[i].get();
 
-            bool pu_equality = std::find(
+            equality[i-1] = std::find(
                 ports_with_equality.begin(),
                 ports_with_equality.end(),
                 std::make_pair(port, PortType::PICKUP)) != ports_with_equality.end();
 
-            bool de_equality = std::find(
+            equality[np-1 + i-1] = std::find(
                 ports_with_equality.begin(),
                 ports_with_equality.end(),
                 std::make_pair(port, PortType::DELIVERY)) != ports_with_equality.end();
+        }
+
+        return equality;
+    }
+
+    void MPSolver::make_rows(IloEnv env, IloRangeArray &port_constr, IloRangeArray &vc_constr) const {
+        auto np = prob->data.num_ports;
+        auto nv = prob->data.num_vessel_classes;
+        std::stringstream cst_name;
+
+        // Port constraints: the equality ones get their lower bound afterwards
+        for(auto i = 1; i < np; i++) {
+            const auto port = prob->data.ports[i].get();
 
             try {
                 cst_name << "port_" << port->name << "_pu";
-                port_constr[i-1] = IloRange(env, pu_equality ? 1.0 : -IloInfinity, 1.0, cst_name.str().c_str());
+                port_constr[i-1] = IloRange(env, -IloInfinity, 1.0, cst_name.str().c_str());
                 cst_name.str("");
 
                 cst_name << "port_" << port->name << "_de";
-                port_constr[np-1 + i-1] = IloRange(env, de_equality ? 1.0 : -IloInfinity, 1.0, cst_name.str().c_str());
+                port_constr[np-1 + i-1] = IloRange(env, -IloInfinity, 1.0, cst_name.str().c_str());
                 cst_name.str("");
             } catch(IloException& e) {
                 std::cerr << "PortRows IloException: " << e << std::endl;
@@ -70,31 +69,63 @@ namespace mvrp {
                 throw;
             }
         }
+    }
 
-        auto col_n = 0;
-        for(auto cit = pool.begin(); cit != pool.end(); ++cit) {
-            IloNumColumn ilo_c = obj(cit->obj_coeff);
-
-            for(auto i = 1; i < np; i++) {
-                try {
-                    ilo_c += port_constr[i - 1](cit->port_coeff[i - 1]); // Pickup port
-                    ilo_c += port_constr[np - 1 + i - 1](cit->port_coeff[np - 1 + i - 1]); // Delivery port
-                } catch(IloException& e) {
-                    std::cerr << "Cols PortRows IloExceptions: " << e << std::endl;
-                    throw;
-                }
+    IloNumVar MPSolver::make_var(const Column &col, IloObjective &obj, IloRangeArray &port_constr, IloRangeArray &vc_constr, IloNumVar::Type type, int col_n) const {
+        auto np = prob->data.num_ports;
+        auto nv = prob->data.num_vessel_classes;
+
+        IloNumColumn ilo_c = obj(col.obj_coeff);
+
+        for(auto i = 1; i < np; i++) {
+            try {
+                ilo_c += port_constr[i - 1](col.port_coeff[i - 1]); // Pickup port
+                ilo_c += port_constr[np - 1 + i - 1](col.port_coeff[np - 1 + i - 1]); // Delivery port
+            } catch(IloException& e) {
+                std::cerr << "Cols PortRows IloExceptions: " << e << std::endl;
+                throw;
             }
-            for(auto i = 0; i < nv; i++) {
-                try {
-                    ilo_c += vc_constr[i](cit->vc_coeff[i]);
-                } catch(IloException& e) {
-                    std::cerr << "Cols VCRows IloExceptions: " << e << std::endl;
-                    throw;
-                }
+        }
+        for(auto i = 0; i < nv; i++) {
+            try {
+                ilo_c += vc_constr[i](col.vc_coeff[i]);
+            } catch(IloException& e) {
+                std::cerr << "Cols VCRows IloExceptions: " << e << std::endl;
+                throw;
             }
+        }
+
+        return IloNumVar(ilo_c, 0, IloInfinity, type, ("theta_" + std::to_string(col_n)).c_str());
+    }
 
-            IloNumVar v(ilo_c, 0, IloInfinity, (linear ? IloNumVar::Float : IloNumVar::Bool), ("theta_" + std::to_string(col_n++)).c_str());
-            var.add(v);
+    MPSolver::IloData MPSolver::solve(const ColumnPool &pool, const std::vector<PortWithType>& ports_with_equality, bool linear, boost::optional<std::string> model_dump) const {
+        // Calculate the sum of all penalties
+        auto all_penalties = 0.0;
+        for(const auto &p : prob->data.ports) {
+            all_penalties += p->pickup_penalty + p->delivery_penalty;
+        }
+
+        IloEnv env;
+        IloModel model(env);
+
+        auto np = prob->data.num_ports;
+
+        IloNumVarArray var(env);
+        IloRangeArray port_constr(env, 2 * (np-1));
+        IloRangeArray vc_constr(env);
+
+        IloObjective obj = IloMinimize(env, all_penalties);
+
+        make_rows(env, port_constr, vc_constr);
+
+        auto equality = equality_rows(ports_with_equality);
+        for(auto i = 0u; i < equality.size(); i++) {
+            if(equality[i]) { port_constr[i].setLB(1.0); }
+        }
+
+        auto col_n = 0;
+        for(const auto &col : pool) {
+            var.add(make_var(col, obj, port_constr, vc_constr, (linear ? IloNumVar::Float : IloNumVar::Bool), col_n++));
         }
 
         model.add(obj);
@@ -131,22 +162,85 @@ namespace mvrp {
         return std::make_tuple(env, var, port_constr, vc_constr, cplex);
     }
 
-    MPLinearSolution MPSolver::solve_lp(const ColumnPool &pool, const std::vector<PortWithType>& ports_with_equality, boost::optional<std::string> model_dump) const {
-        IloEnv env;
-        IloNumVarArray var;
-        IloRangeArray port_constr;
-        IloRangeArray vc_constr;
-        IloCplex cplex;
+    void MPSolver::build_lp(const std::vector<PortWithType>& ports_with_equality) {
+        // Calculate the sum of all penalties
+        auto all_penalties = 0.0;
+        for(const auto &p : prob->data.ports) {
+            all_penalties += p->pickup_penalty + p->delivery_penalty;
+        }
 
         auto np = prob->data.num_ports;
 
-        std::tie(env, var, port_constr, vc_constr, cplex) = solve(pool, ports_with_equality, true, model_dump);
+        lp = std::make_unique<LPModel>();
+        lp->obj = IloMinimize(lp->env, all_penalties);
+        lp->port_constr = IloRangeArray(lp->env, 2 * (np-1));
+        lp->vc_constr = IloRangeArray(lp->env);
 
-        auto obj_value = cplex.getObjValue();
+        make_rows(lp->env, lp->port_constr, lp->vc_constr);
 
-        IloNumArray values(env);
+        lp->equality = equality_rows(ports_with_equality);
+        for(auto i = 0u; i < lp->equality.size(); i++) {
+            if(lp->equality[i]) { lp->port_constr[i].setLB(1.0); }
+        }
+
+        lp->model.add(lp->obj);
+        lp->model.add(lp->port_constr);
+        lp->model.add(lp->vc_constr);
+
+        lp->cplex = IloCplex(lp->model);
+        lp->cplex.setParam(IloCplex::Threads, prob->params.cplex_cores);
+        lp->cplex.setOut(lp->env.getNullStream());
+
+        // New columns keep the previous basis primal feasible
+        lp->cplex.setParam(IloCplex::RootAlg, IloCplex::Primal);
+        lp->cplex.setParam(IloCplex::AdvInd, 1);
+    }
+
+    MPLinearSolution MPSolver::solve_lp(const ColumnPool &pool, const std::vector<PortWithType>& ports_with_equality, boost::optional<std::string> model_dump) {
+        // The pool can only grow between two calls: if it did not, we start over
+        if(!lp || pool.size() < (std::size_t) lp->var.getSize()) { build_lp(ports_with_equality); }
+
+        auto np = prob->data.num_ports;
+
+        // The equality rows are switched by changing their lower bound
+        auto equality = equality_rows(ports_with_equality);
+        for(auto i = 0u; i < equality.size(); i++) {
+            if(equality[i] != lp->equality[i]) { lp->port_constr[i].setLB(equality[i] ? 1.0 : -IloInfinity); }
+        }
+        lp->equality = equality;
+
+        // The variables of the new columns are added to the model through the objective and the rows
+        for(auto col_n = lp->var.getSize(); col_n < (IloInt) pool.size(); col_n++) {
+            lp->var.add(make_var(pool[col_n], lp->obj, lp->port_constr, lp->vc_constr, IloNumVar::Float, col_n));
+        }
+
+        if(model_dump) {
+            std::string output_name = *model_dump + ".lp";
+            try {
+                lp->cplex.exportModel(output_name.c_str());
+            } catch(IloException& e) {
+                std::cerr << "Export IloException: " << e << std::endl;
+            }
+        }
+
+        auto solved = false;
+
+        try {
+            solved = lp->cplex.solve();
+        } catch(IloException &e) {
+            std::cerr << "Solve IloException: " << e << std::endl;
+            throw;
+        }
+
+        if(!solved) {
+            throw std::runtime_error("Infeasible problem!");
+        }
+
+        auto obj_value = lp->cplex.getObjValue();
+
+        IloNumArray values(lp->env);
 
-        cplex.getDuals(values, port_constr);
+        lp->cplex.getDuals(values, lp->port_constr);
 
         auto port_duals = PortDuals();
         for(auto i = 1; i <= (values.getSize() / 2); i++) {
@@ -154,7 +248,7 @@ namespace mvrp {
             port_duals.emplace(p, std::make_pair(values[i - 1], values[np - 1 + i - 1]));
         }
 
-        cplex.getDuals(values, vc_constr);
+        lp->cplex.getDuals(values, lp->vc_constr);
 
         auto vc_duals = VcDuals();
         for(auto i = 0; i < values.getSize(); i++) {
@@ -162,7 +256,7 @@ namespace mvrp {
             vc_duals.emplace(vc, values[i]);
         }
 
-        cplex.getValues(values, var);
+        lp->cplex.getValues(values, lp->var);
 
         auto variables = std::vector<double>();
         for(auto i = 0; i < values.getSize(); i++) {
@@ -170,11 +264,22 @@ namespace mvrp {
         }
 
         values.end();
-        env.end();
 
         return MPLinearSolution(obj_value, port_duals, vc_duals, variables);
     }
 
+    void MPSolver::remove_columns(const std::vector<bool> &removed) {
+        if(!lp) { return; }
+
+        // Ending a variable removes it from the objective, the rows and the model
+        for(auto col_n = std::min((IloInt) removed.size(), lp->var.getSize()) - 1; col_n >= 0; col_n--) {
+            if(removed[col_n]) {
+                lp->var[col_n].end();
+                lp->var.remove(col_n);
+            }
+        }
+    }
+
     MPIntegerSolution MPSolver::solve_mip(const ColumnPool &pool, const std::vector<PortWithType>& ports_with_equality) const {
         IloEnv env;
         IloNumVarArray var;
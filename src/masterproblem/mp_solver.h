@@ -8,6 +8,7 @@
 #include <cstring>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include <ilcplex/ilocplex.h>
 
@@ -22,12 +23,47 @@ namespace mvrp {
 
         MPSolver(std::shared_ptr<const Problem> prob) : prob(prob) {}
 
-        MPLinearSolution solve_lp(const ColumnPool &pool, const std::vector<PortWithType>& ports_with_equality, boost::optional<std::string> model_dump = boost::none) const;
+        /* The LP is kept from one call to the next: pool must contain the columns it was given at the previous
+         * call, in the same order and except for those removed with remove_columns, followed by the new ones.
+         * Only the new columns are added, the bounds of the port rows are updated if ports_with_equality
+         * changed, and CPLEX starts from the previous basis. */
+        MPLinearSolution solve_lp(const ColumnPool &pool, const std::vector<PortWithType>& ports_with_equality, boost::optional<std::string> model_dump = boost::none);
+
+        /* Removes from the LP the columns flagged in removed, which is indexed as the pool given at the last
+         * call of solve_lp. They should not be in the last LP solution, so that its basis stays valid. */
+        void remove_columns(const std::vector<bool> &removed);
+
         MPIntegerSolution solve_mip(const ColumnPool &pool, const std::vector<PortWithType>& ports_with_equality) const;
 
     private:
         using IloData = std::tuple<IloEnv, IloNumVarArray, IloRangeArray, IloRangeArray, IloCplex>;
         IloData solve(const ColumnPool &pool, const std::vector<PortWithType>& ports_with_equality, bool linear, boost::optional<std::string> model_dump = boost::none) const;
+
+        /* Objects of the LP model which live as long as the solver */
+        struct LPModel {
+            IloEnv env;
+            IloModel model;
+            IloObjective obj;
+            IloNumVarArray var;
+            IloRangeArray port_constr;
+            IloRangeArray vc_constr;
+            IloCplex cplex;
+
+            /* Whether each port row is currently an equality */
+            std::vector<bool> equality;
+
+            LPModel() : model{env}, var{env} {}
+            LPModel(const LPModel&) = delete;
+            LPModel& operator=(const LPModel&) = delete;
+            ~LPModel() { env.end(); }
+        };
+
+        std::unique_ptr<LPModel> lp;
+
+        void build_lp(const std::vector<PortWithType>& ports_with_equality);
+        void make_rows(IloEnv env, IloRangeArray &port_constr, IloRangeArray &vc_constr) const;
+        std::vector<bool> equality_rows(const std::vector<PortWithType>& ports_with_equality) const;
+        IloNumVar make_var(const Column &col, IloObjective &obj, IloRangeArray &port_constr, IloRangeArray &vc_constr, IloNumVar::Type type, int col_n) const;
     };
 }
 
@@ -2,12 +2,27 @@
 //  Copyright (c) 2013 Alberto Santini. All rights reserved.
 //
 
+#include <stdexcept>
+
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
 
 #include "program_params.h"
 
 namespace mvrp {
+    static PricingEngine pricing_engine(const std::string &name) {
+        if(name == "labelling") { return PricingEngine::LABELLING; }
+        if(name == "pulse") { return PricingEngine::PULSE; }
+        throw std::runtime_error("Unknown pricing engine: " + name);
+    }
+
+    static PartialPricing partial_pricing_order(const std::string &name) {
+        if(name == "none") { return PartialPricing::NONE; }
+        if(name == "round_robin") { return PartialPricing::ROUND_ROBIN; }
+        if(name == "recent_success") { return PartialPricing::RECENT_SUCCESS; }
+        throw std::runtime_error("Unknown partial pricing order: " + name);
+    }
+
     ProgramParams::ProgramParams(const std::string &data_file_name) {
         using namespace boost::property_tree;
 
@@ -18,15 +33,43 @@ namespace mvrp {
         early_branching = pt.get<bool>("early_branching");
         enable_cost_prize_acceleration = pt.get<bool>("enable_cost_prize_acceleration");
         enable_prize_acceleration = pt.get<bool>("enable_prize_acceleration");
+        dssr_elementary_labelling = pt.get<bool>("dssr_elementary_labelling");
+        global_pool_pricing = pt.get<bool>("global_pool_pricing");
+        local_search_pricing = pt.get<bool>("local_search_pricing");
+        beam_labelling_cost_only_dominance = pt.get<bool>("beam_labelling_cost_only_dominance");
         greedy_max_outarcs = pt.get<int>("greedy_max_outarcs");
         greedy_reruns = pt.get<int>("greedy_reruns");
+        pricing_threads = pt.get<unsigned int>("pricing_threads");
+        pricing_racing = pt.get<bool>("pricing_racing");
+        racing_target_columns = pt.get<unsigned int>("racing_target_columns");
+        adaptive_pricing = pt.get<bool>("adaptive_pricing");
+        asynchronous_column_generation = pt.get<bool>("asynchronous_column_generation");
+        dual_smoothing_alpha = pt.get<double>("dual_smoothing_alpha");
+        dual_smoothing_in_out = pt.get<bool>("dual_smoothing_in_out");
+        adaptive_pricing_exploration = pt.get<double>("adaptive_pricing_exploration");
+        partial_pricing_min_columns = pt.get<unsigned int>("partial_pricing_min_columns");
+        max_columns_per_iteration = pt.get<unsigned int>("max_columns_per_iteration");
+        column_max_age = pt.get<unsigned int>("column_max_age");
+        column_aging_rc_threshold = pt.get<double>("column_aging_rc_threshold");
+        max_local_pool_size = pt.get<unsigned int>("max_local_pool_size");
+        tailing_off_window = pt.get<unsigned int>("tailing_off_window");
+        tailing_off_threshold = pt.get<double>("tailing_off_threshold");
+        random_seed = pt.get<unsigned int>("random_seed");
+        beam_labelling_width = pt.get<unsigned int>("beam_labelling_width");
+        sparse_pricing_out_arcs = pt.get<unsigned int>("sparse_pricing_out_arcs");
         elementary_labelling_every_n_nodes = pt.get<int>("elementary_labelling_every_n_nodes");
         max_cols_to_solve_mp = pt.get<int>("max_cols_to_solve_mp");
         cplex_cores = pt.get<int>("cplex_cores");
         time_limit_in_s = pt.get<int>("time_limit_in_s");
         early_branching_timeout = pt.get<int>("early_branching_timeout");
+        exact_pricing_max_columns = pt.get<unsigned int>("exact_pricing_max_columns");
         dummy_column_price = pt.get<long>("dummy_column_price");
         cp_acceleration_arcs_share = pt.get<double>("cp_acceleration_arcs_share");
         p_acceleration_max_arcs_share = pt.get<double>("p_acceleration_max_arcs_share");
+        exact_pricing_rc_threshold = pt.get<double>("exact_pricing_rc_threshold");
+        elementary_pricing_engine = pricing_engine(pt.get<std::string>("elementary_pricing_engine"));
+        exact_pricing_engine = pricing_engine(pt.get<std::string>("exact_pricing_engine"));
+        partial_pricing = partial_pricing_order(pt.get<std::string>("partial_pricing"));
+        labelling_stats_file = pt.get<std::string>("labelling_stats_file");
     }
 }
@@ -8,22 +8,64 @@
 #include <string>
 
 namespace mvrp {
+    /* Algorithm used to solve a pricing problem: label-setting or depth-first pulse */
+    enum class PricingEngine {
+        LABELLING, PULSE
+    };
+
+    /* Order in which partial pricing goes through the vessel classes: none prices them all at once */
+    enum class PartialPricing {
+        NONE, ROUND_ROBIN, RECENT_SUCCESS
+    };
+
     class ProgramParams {
     public:
         bool parallel_labelling;
+        bool pricing_racing;
+        bool adaptive_pricing;
+        /* Before the synchronous column generation at each node, price in a separate thread while the master
+           is solved again. This phase uses the raw LP duals (no dual smoothing) and does not age or purge the
+           columns. */
+        bool asynchronous_column_generation;
+        bool dual_smoothing_in_out;
         bool early_branching;
         bool enable_cost_prize_acceleration;
         bool enable_prize_acceleration;
+        bool dssr_elementary_labelling;
+        bool global_pool_pricing;
+        bool local_search_pricing;
+        bool beam_labelling_cost_only_dominance;
         int greedy_max_outarcs;
         int greedy_reruns;
+        unsigned int pricing_threads;
+        unsigned int racing_target_columns;
+        unsigned int partial_pricing_min_columns;
+        unsigned int max_columns_per_iteration;
+        unsigned int column_max_age;
+        unsigned int max_local_pool_size;
+        unsigned int tailing_off_window;
+        unsigned int random_seed;
+        unsigned int beam_labelling_width;
+        unsigned int sparse_pricing_out_arcs;
         int elementary_labelling_every_n_nodes;
         int max_cols_to_solve_mp;
         int cplex_cores;
         int time_limit_in_s;
         int early_branching_timeout;
+        unsigned int exact_pricing_max_columns;
         long dummy_column_price;
         double cp_acceleration_arcs_share;
         double p_acceleration_max_arcs_share;
+        double exact_pricing_rc_threshold;
+        double adaptive_pricing_exploration;
+        double tailing_off_threshold;
+        double dual_smoothing_alpha;
+        double column_aging_rc_threshold;
+        PricingEngine elementary_pricing_engine;
+        PricingEngine exact_pricing_engine;
+        PartialPricing partial_pricing;
+        /* CSV file to which the labelling statistics of each node are appended (if compiled in); empty for none */
+        std::string labelling_stats_file;
 
         ProgramParams(const std::string &data_file_name = "data/program_params.json");
     };
@@ -2,29 +2,18 @@
 //  Copyright (c) 2013 Alberto Santini. All rights reserved.
 //
 
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <string>
+
 #include "_labelling.h"
 
 namespace mvrp {
-
-    bool operator==(const Label& lhs, const Label& rhs) {
-        return( lhs.del == rhs.del &&
-                lhs.pic == rhs.pic &&
-                std::abs(lhs.cost - rhs.cost) < Label::EPS);
-    }
-
-    bool operator!=(const Label& lhs, const Label& rhs) {
-        return !(lhs == rhs);
-    }
-
-    bool operator<=(const Label& lhs, const Label& rhs) {
-        if(rhs.cost < lhs.cost - Label::EPS) { return false; }
-        if(rhs.del > lhs.del) { return false; }
-        if(rhs.pic > lhs.pic) { return false; }
-        return true;
-    }
-
-    bool operator<(const Label& lhs, const Label& rhs) {
-        return lhs <= rhs && lhs != rhs;
+    unsigned int PortSlots::count() const {
+        auto n = 0u;
+        for(auto i = 0u; i < max_slots; i++) { if(test(i)) { ++n; } }
+        return n;
     }
 
     std::ostream& operator<<(std::ostream& out, const Label& l) {
@@ -32,104 +21,63 @@ namespace mvrp {
         return out;
     }
 
-    bool operator==(const ElementaryLabel& lhs, const ElementaryLabel& rhs) {
-        return( lhs.del == rhs.del &&
-                lhs.por == rhs.por &&
-                std::abs(lhs.cost - rhs.cost) < Label::EPS);
+    std::ostream& operator<<(std::ostream& out, const ElementaryLabel& l) {
+        out << "(cost: " << l.cost << ", pic: " << l.pic << ", del: " << l.del << ", visited: " << l.visited.count() << " ports)";
+        return out;
     }
 
-    bool operator!=(const ElementaryLabel& lhs, const ElementaryLabel& rhs) {
-        return !(lhs == rhs);
-    }
+    LabelExtender::LabelExtender(const Graph& g, const ErasedEdges& erased, const VisitablePorts* critical_ports) : g{g} {
+        const auto& graph = g.graph;
+        auto n_vertices = num_vertices(graph);
+        auto n_edges = num_edges(graph);
+
+        pu_demand = std::vector<int>(n_vertices, 0);
+        de_demand = std::vector<int>(n_vertices, 0);
+        prize = std::vector<double>(n_vertices, 0.0);
+        slot = std::vector<int>(n_vertices, no_slot);
+        arc_cost = std::vector<double>(n_edges, 0.0);
+        erased_edge = std::vector<char>(n_edges, 0);
+
+        // Each port gets an index, in the order in which it is first met
+        std::map<Port*, int> port_index;
 
-    bool operator<=(const ElementaryLabel& lhs, const ElementaryLabel& rhs) {
-        if(rhs.cost < lhs.cost - Label::EPS) { return false; }
-        if(rhs.del > lhs.del) { return false; }
-        if(rhs.pic > lhs.pic) { return false; }
-    
-        // If there is any port visitable by RHS...
-        if(std::any_of(
-            rhs.por.begin(),
-            rhs.por.end(),
-            [&] (const auto& vp) {
-                // ...that is not visitable by LHS
-                return std::find(lhs.por.begin(), lhs.por.end(), vp) == lhs.por.end();
+        for(auto vp = vertices(graph); vp.first != vp.second; ++vp.first) {
+            const Node& n = *graph[*vp.first];
+            auto id = n.boost_vertex_id;
+
+            // Port demands are integer
+            pu_demand[id] = static_cast<int>(n.pu_demand());
+            de_demand[id] = static_cast<int>(n.de_demand());
+            prize[id] = g.dual_of(n) + n.penalty();
+
+            if(n.n_type == NodeType::SOURCE_VERTEX) { continue; }
+
+            if(n.n_type == NodeType::COMEBACK_HUB) {
+                if(!critical_ports) { slot[id] = forbidden_slot; }
+                continue;
             }
-        )) { return false; }
-    
-        return true;
-    }
 
-    bool operator<(const ElementaryLabel& lhs, const ElementaryLabel& rhs) {
-        return lhs <= rhs && lhs != rhs;
-    }
+            auto is_critical = !critical_ports || std::find(critical_ports->begin(), critical_ports->end(), std::make_pair(n.port, n.pu_type)) != critical_ports->end();
 
-    std::ostream& operator<<(std::ostream& out, const ElementaryLabel& l) {
-        out << "(cost: " << l.cost << ", pic: " << l.pic << ", del: " << l.del << ", visitable: " << l.por.size() << " ports)";
-        return out;
-    }
+            if(!is_critical) { continue; }
 
-    boost::optional<Label> LabelExtender::operator()(const BGraph& graph, const Label& label, const Edge& e) const {
-        const Arc& arc = *graph[e];
-    
-        const Vertex& src_vertex = source(e, graph);
-        const Vertex& trg_vertex = target(e, graph);
-    
-        const Node& trg_node = *graph[trg_vertex];
-    
-        // Erased edge, sorry!
-        if(erased.find(src_vertex) != erased.end() && erased.at(src_vertex).find(e) != erased.at(src_vertex).end()) { return boost::none; }
-    
-        Label new_label = label;
-        
-        // Not enough pickup "space", sorry!
-        if(label.pic < trg_node.pu_demand()) { return boost::none; }
-    
-        new_label.pic = label.pic - trg_node.pu_demand();
-    
-        // Not enough delivery "space", sorry!
-        if(label.del < trg_node.de_demand()) { return boost::none; }
-    
-        new_label.del = std::min(label.pic - trg_node.pu_demand(), label.del - trg_node.de_demand());
-    
-        new_label.cost = label.cost + arc.cost - label.g.dual_of(trg_node) - trg_node.penalty();
-    
-        return new_label;
-    }
+            auto idx = port_index.emplace(n.port.get(), (int) port_index.size()).first->second;
+            auto s = 2 * idx + (n.pu_type == PortType::DELIVERY ? 1 : 0);
+
+            if(s >= (int) PortSlots::max_slots) {
+                throw std::runtime_error("Elementary labels can only track " + std::to_string(PortSlots::max_slots / 2) + " ports");
+            }
+
+            slot[id] = s;
+        }
+
+        for(auto ep = edges(graph); ep.first != ep.second; ++ep.first) {
+            auto id = graph[*ep.first]->boost_edge_id;
+            arc_cost[id] = graph[*ep.first]->cost;
+        }
 
-    boost::optional<ElementaryLabel> LabelExtender::operator()(const BGraph& graph, const ElementaryLabel& label, const Edge& e) const {
-        const Arc& arc = *graph[e];
-    
-        const Vertex& src_vertex = source(e, graph);
-        const Vertex& trg_vertex = target(e, graph);
-    
-        const Node& trg_node = *graph[trg_vertex];
-    
-        auto dest_port = std::make_pair(trg_node.port, trg_node.pu_type);
-    
-        // Erased edge, sorry!
-        if(erased.find(src_vertex) != erased.end() && erased.at(src_vertex).find(e) != erased.at(src_vertex).end()) { return boost::none; }
-    
-        // Target port not visitable, sorry!
-        if(std::find(label.por.begin(), label.por.end(), dest_port) == label.por.end()) { return boost::none; }
-    
-        ElementaryLabel new_label = label;
-    
-        new_label.por = label.por;
-        new_label.por.erase(std::remove(new_label.por.begin(), new_label.por.end(), dest_port), new_label.por.end());
-    
-        // Not enough pickup "space", sorry!
-        if(label.pic < trg_node.pu_demand()) { return boost::none; }
-    
-        new_label.pic = label.pic - trg_node.pu_demand();
-    
-        // Not enough delivery "space", sorry!
-        if(label.del < trg_node.de_demand()) { return boost::none; }
-    
-        new_label.del = std::min(label.pic - trg_node.pu_demand(), label.del - trg_node.de_demand());
-    
-        new_label.cost = label.cost + arc.cost - label.g.dual_of(trg_node) - trg_node.penalty();
-    
-        return new_label;
+        for(const auto& ee : erased) {
+            for(const auto& e : ee.second) { erased_edge[graph[e]->boost_edge_id] = 1; }
+        }
     }
-}
\ No newline at end of file
+}
@@ -5,87 +5,178 @@
 #ifndef LABELLING_H
 #define LABELLING_H
 
-#include <set>
-#include <map>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <numeric>
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 #include <functional>
+#include <mutex>
+#include <type_traits>
 #include <boost/optional.hpp>
 
+#include "../base/cancellation.h"
 #include "../base/graph.h"
+#include "../base/task_pool.h"
 #include "../column/solution.h"
+#include "labelling_stats.h"
 
 namespace mvrp {
-    using VisitablePorts = std::vector<std::pair<std::shared_ptr<Port>, PortType>>;
+    /**
+     * Set of (port, pickup/delivery) slots, used to remember which ports a partial path has visited.
+     * Each regular port has two slots: one for its pickup vertices and one for its delivery vertices.
+     */
+    class PortSlots {
+        static constexpr unsigned int bits_per_word = 64u;
+        static constexpr unsigned int n_words = 2u;
+
+        std::uint64_t words[n_words];
 
-    class Label {
     public:
-        const Graph& g;
+        static constexpr unsigned int max_slots = bits_per_word * n_words;
+
+        void clear() { for(auto& w : words) { w = 0u; } }
+        bool test(unsigned int slot) const { return (words[slot / bits_per_word] >> (slot % bits_per_word)) & 1u; }
+        void set(unsigned int slot) { words[slot / bits_per_word] |= (std::uint64_t{1u} << (slot % bits_per_word)); }
+        unsigned int count() const;
+
+        bool is_subset_of(const PortSlots& other) const {
+            for(auto i = 0u; i < n_words; i++) { if(words[i] & ~other.words[i]) { return false; } }
+            return true;
+        }
+    };
+
+    /**
+     * Label for the SPPRC with capacity constraints. Labels are plain trivially-copyable structs:
+     * all the information about the graph needed to extend them is kept by the LabelExtender.
+     */
+    struct Label {
         int pic; // Qty it's possible to pickup
         int del; // Qty it's possible to deliver
-        int tdel; // Total qty delivered
         double cost;
 
         static constexpr double EPS = 0.001;
 
-        Label(  const Graph& g,
-                int pic,
-                int del,
-                double cost) :
-                g{g},
-                pic{pic},
-                del{del},
-                tdel{tdel},
-                cost{cost} {}
-
-        Label(  const Graph& g) :
-                g{g},
-                pic{g.vessel_class->capacity},
-                del{g.vessel_class->capacity},
-                cost{0.0} {}
+        /* Whether the label remembers the visited ports, to enforce elementarity */
+        static constexpr bool elementary = false;
+
+        static Label initial(int capacity) { return Label{capacity, capacity, 0.0}; }
+
+        bool weakly_dominates(const Label& other) const {
+            return cost <= other.cost + EPS && pic >= other.pic && del >= other.del;
+        }
     };
 
-    class ElementaryLabel : public Label {
-    public:
-        VisitablePorts por;
+    /**
+     * Label for the ESPPRC with capacity constraints. It also remembers which critical ports have been visited.
+     */
+    struct ElementaryLabel {
+        int pic; // Qty it's possible to pickup
+        int del; // Qty it's possible to deliver
+        double cost;
+        PortSlots visited; // Critical ports already visited
 
-        ElementaryLabel(const Graph& g,
-                        int pic,
-                        int del,
-                        double cost,
-                        VisitablePorts por) :
-                        Label{g, pic, del, cost},
-                        por{por} {}
+        static constexpr bool elementary = true;
 
-        ElementaryLabel(const Graph& g,
-                        VisitablePorts por) :
-                        Label{g},
-                        por{por} {}
+        static ElementaryLabel initial(int capacity) {
+            return ElementaryLabel{capacity, capacity, 0.0, PortSlots{}};
+        }
 
+        bool weakly_dominates(const ElementaryLabel& other) const {
+            return cost <= other.cost + Label::EPS && pic >= other.pic && del >= other.del && visited.is_subset_of(other.visited);
+        }
     };
 
+    static_assert(std::is_trivially_copyable<Label>::value, "Labels must be trivially copyable");
+    static_assert(std::is_trivially_copyable<ElementaryLabel>::value, "Labels must be trivially copyable");
+
+    /**
+     * A label dominates another one if it is at least as good on all resources, and strictly better on at least one.
+     */
+    template<typename Lbl>
+    inline bool dominates(const Lbl& l1, const Lbl& l2) {
+        return l1.weakly_dominates(l2) && !l2.weakly_dominates(l1);
+    }
+
+    /**
+     * Extends labels along the edges of a graph. When it is created, it takes a snapshot of everything
+     * needed from the graph (demands, dual prizes, arc costs, erased edges) into arrays indexed by vertex
+     * and edge ids, so that extending a label does not need any lookup in the graph.
+     */
     class LabelExtender {
-    public:
-        const ErasedEdges& erased;
+        const Graph& g;
+        std::vector<int> pu_demand;         // Indexed by vertex id
+        std::vector<int> de_demand;         // Indexed by vertex id
+        std::vector<double> prize;          // Indexed by vertex id: dual value plus penalty
+        std::vector<int> slot;              // Indexed by vertex id: slot of a critical port, no_slot or forbidden_slot
+        std::vector<double> arc_cost;       // Indexed by edge id
+        std::vector<char> erased_edge;      // Indexed by edge id
+
+        static constexpr int no_slot = -1;          // Elementarity is not enforced on the vertex
+        static constexpr int forbidden_slot = -2;   // Elementary paths cannot visit the vertex
+
+        bool visit(Label&, int) const { return true; }
+        bool visit(ElementaryLabel& label, int s) const {
+            if(s == no_slot) { return true; }
+            if(s == forbidden_slot) { return false; }
+            if(label.visited.test(s)) { return false; }
+            label.visited.set(s);
+            return true;
+        }
 
-        LabelExtender(const ErasedEdges& erased) : erased{erased} {}
+    public:
+        /**
+         * @param g                 The graph
+         * @param erased            Edges which cannot be used
+         * @param critical_ports    Ports on which elementarity is enforced when extending an ElementaryLabel.
+         *                          If it is null, elementarity is enforced on all ports and elementary paths
+         *                          cannot go back to the hub. Otherwise, ports not in the list can be visited
+         *                          any number of times.
+         */
+        LabelExtender(const Graph& g, const ErasedEdges& erased, const VisitablePorts* critical_ports = nullptr);
+
+        bool is_erased(const Edge& e) const { return erased_edge[g.graph[e]->boost_edge_id]; }
+
+        /* Contribution of an edge to the reduced cost of a path: its cost minus the prize at its target */
+        double reduced_cost(const Edge& e) const {
+            return arc_cost[g.graph[e]->boost_edge_id] - prize[g.graph[target(e, g.graph)]->boost_vertex_id];
+        }
 
-        boost::optional<Label> operator()(const BGraph& graph, const Label& label, const Edge& e) const;
-        boost::optional<ElementaryLabel> operator()(const BGraph& graph, const ElementaryLabel& label, const Edge& e) const;
+        /**
+         * Extends a label along an edge.
+         * @param label     The label to extend
+         * @param e         The edge
+         * @param new_label Where to write the extended label
+         * @return          True iff the extension is feasible
+         */
+        template<typename Lbl>
+        bool operator()(const Lbl& label, const Edge& e, Lbl& new_label) const {
+            const auto eid = g.graph[e]->boost_edge_id;
+            const auto tid = g.graph[target(e, g.graph)]->boost_vertex_id;
+
+            // Erased edge, sorry!
+            if(erased_edge[eid]) { return false; }
+
+            // Not enough pickup "space", sorry!
+            if(label.pic < pu_demand[tid]) { return false; }
+
+            // Not enough delivery "space", sorry!
+            if(label.del < de_demand[tid]) { return false; }
+
+            new_label = label;
+            new_label.pic = label.pic - pu_demand[tid];
+            new_label.del = std::min(label.pic - pu_demand[tid], label.del - de_demand[tid]);
+            new_label.cost = label.cost + arc_cost[eid] - prize[tid];
+
+            // Target port already visited, sorry!
+            return visit(new_label, slot[tid]);
+        }
     };
 
-    bool operator==(const Label& lhs, const Label& rhs);
-    bool operator!=(const Label& lhs, const Label& rhs);
-    bool operator<=(const Label& lhs, const Label& rhs);
-    bool operator<(const Label& lhs, const Label& rhs);
     std::ostream& operator<<(std::ostream& out, const Label& l);
-
-    bool operator==(const ElementaryLabel& lhs, const ElementaryLabel& rhs);
-    bool operator!=(const ElementaryLabel& lhs, const ElementaryLabel& rhs);
-    bool operator<=(const ElementaryLabel& lhs, const ElementaryLabel& rhs);
-    bool operator<(const ElementaryLabel& lhs, const ElementaryLabel& rhs);
     std::ostream& operator<<(std::ostream& out, const ElementaryLabel& l);
 
     /* ============================================= */
@@ -95,267 +186,311 @@ namespace mvrp {
     public:
         Lbl label;
         const LblContainer* pred_container;
-        const BGraph& g;
-        boost::optional<const Edge> pred_edge;
+        boost::optional<Edge> pred_edge;
         mutable bool dominated;
 
         LblContainer(   Lbl label,
                         const LblContainer* pred_container,
-                        const BGraph& g,
                         const Edge pred_edge) :
                         label{label},
                         pred_container{pred_container},
-                        g{g},
                         pred_edge{pred_edge},
                         dominated{false} {}
 
-        LblContainer(   Lbl label,
-                        const BGraph& g) :
+        LblContainer(   Lbl label) :
                         label{label},
                         pred_container{nullptr},
-                        g{g},
                         pred_edge{boost::none},
                         dominated{false} {}
     };
 
     template<typename Lbl>
-    struct LblContainerComp {
-      bool operator()(const LblContainer<Lbl>& c1, const LblContainer<Lbl>& c2) const {
-          if(c1.label.pic > c1.label.pic) { return true; }
-          if(c1.label.del > c2.label.del) { return true; }
-          return (c1.label.cost < c2.label.cost);
-      }
+    using LblContainers = std::vector<LblContainer<Lbl>>;
+
+    /**
+     * Options controlling when the labelling algorithm can stop before exhausting all labels.
+     */
+    struct LabellingOptions {
+        /**
+         * Max number of columns to return. If at least this many labels with cost below rc_threshold
+         * reach the end vertex, the algorithm stops early and returns the best max_columns of them.
+         * 0 means no limit: the algorithm runs to completion and returns all labels at the end vertex.
+         */
+        unsigned int max_columns;
+
+        /**
+         * Only labels at the end vertex with cost strictly below this threshold count towards max_columns.
+         */
+        double rc_threshold;
+
+        /**
+         * Max number of labels kept at each vertex (except the end vertex): if there are more undominated
+         * labels, only the cheapest ones are kept. 0 means no limit. With a limit, the algorithm is a
+         * heuristic (beam search).
+         */
+        unsigned int max_labels_per_vertex;
+
+        /**
+         * If true, a label dominates another one as soon as it is cheaper, regardless of the resources.
+         * This makes the algorithm a heuristic.
+         */
+        bool cost_only_dominance;
+
+        /**
+         * When this token is cancelled, the algorithm stops and returns the labels it already has at the end vertex.
+         */
+        CancellationToken cancellation;
+
+        /**
+         * If not null, the statistics of the run are added to it.
+         */
+        LabellingStats* stats;
+
+        /**
+         * How many extensions to perform between two checks of the cancellation token.
+         */
+        static constexpr unsigned int cancellation_check_interval = 4096u;
+
+        LabellingOptions(unsigned int max_columns = 0u, double rc_threshold = 0.0, unsigned int max_labels_per_vertex = 0u, bool cost_only_dominance = false, CancellationToken cancellation = CancellationToken(), LabellingStats* stats = nullptr) :
+                         max_columns{max_columns},
+                         rc_threshold{rc_threshold},
+                         max_labels_per_vertex{max_labels_per_vertex},
+                         cost_only_dominance{cost_only_dominance},
+                         cancellation{cancellation},
+                         stats{stats} {}
     };
 
-    template<typename Lbl>
-    class ContainersSet {
-        std::set<LblContainer<Lbl>, LblContainerComp<Lbl>> set;
+    /**
+     * Labelling algorithm on the (acyclic) time-expanded graph. Vertices are processed level by level,
+     * following the graph's topological levels: when a level is processed, all labels at previous levels
+     * are final, so each vertex of the level can independently pull the labels of its predecessors,
+     * extend them and remove the dominated ones. If a task pool is given, the vertices of the same
+     * level are processed in parallel. The result does not depend on the number of threads.
+     */
+    template<typename Lbl, typename LblExt>
+    class LabellingAlgorithm {
+        std::shared_ptr<const Graph> g;
+        TaskPool* pool;
 
-    public:
-        using iterator = typename std::set<LblContainer<Lbl>, LblContainerComp<Lbl>>::iterator;
+        static bool dominates(const Lbl& l1, const Lbl& l2, bool cost_only) {
+            return cost_only ? l1.cost < l2.cost - Label::EPS : mvrp::dominates(l1, l2);
+        }
 
-        ContainersSet(std::initializer_list<LblContainer<Lbl>> l) : set{l} {}
-        ContainersSet() {}
+        bool add_if_undominated(LblContainers<Lbl>& containers, const LblContainer<Lbl>& candidate, bool cost_only, LabellingStats& stats) const;
+        LblContainers<Lbl> undominated(const LblContainers<Lbl>& candidates, const LabellingOptions& options, LabellingStats& stats) const;
 
-        friend auto begin(const ContainersSet& s) { return s.set.begin(); }
-        friend auto end(const ContainersSet& s) { return s.set.end(); }
+    public:
+        LabellingAlgorithm(std::shared_ptr<const Graph> g, TaskPool* pool = nullptr) : g{g}, pool{pool} {}
+        std::vector<Solution> solve(Vertex start_v, Vertex end_v, Lbl start_label, LblExt extension, LabellingOptions options = LabellingOptions()) const;
+    };
 
-        bool has_undominated_labels() const {
-            if(set.empty()) { return false; }
-            if(std::any_of(set.begin(), set.end(), [] (const LblContainer<Lbl>& c) { return !c.dominated; })) { return true; }
+    template<typename Lbl, typename LblExt>
+    bool LabellingAlgorithm<Lbl, LblExt>::add_if_undominated(LblContainers<Lbl>& containers, const LblContainer<Lbl>& candidate, bool cost_only, LabellingStats& stats) const {
+        if(std::any_of(containers.begin(), containers.end(),
+            [&candidate, cost_only] (const LblContainer<Lbl>& c) { return !c.dominated && dominates(c.label, candidate.label, cost_only); }
+        )) {
+            if(LABELLING_STATS) { ++stats.dominated_unprocessed; }
             return false;
         }
 
-        auto first_undominated_container() const {
-            for(auto it = set.begin(); it != set.end(); ++it) { if(!it->dominated) { return it; } }
-            return set.end();
+        for(const auto& c : containers) {
+            if(!c.dominated && dominates(candidate.label, c.label, cost_only)) {
+                c.dominated = true;
+                if(LABELLING_STATS) { ++stats.dominated_undominated; }
+            }
         }
 
-        const iterator begin() const { return set.begin(); }
-        const iterator end() const { return set.end(); }
-        iterator begin() { return set.begin(); }
-        iterator end() { return set.end(); }
-        auto insert(LblContainer<Lbl> l) { return set.insert(l); }
-        auto erase(const iterator& l) { return set.erase(l); }
-        auto size() const { return set.size(); }
-        auto empty() const { return set.empty(); }
-        void mark_dominated(iterator l) {
-            assert(l != set.end());
-            l->dominated = true;
+        containers.push_back(candidate);
+        return true;
+    }
+
+    template<typename Lbl, typename LblExt>
+    LblContainers<Lbl> LabellingAlgorithm<Lbl, LblExt>::undominated(const LblContainers<Lbl>& candidates, const LabellingOptions& options, LabellingStats& stats) const {
+        // Cheap labels first, as they are the most likely to dominate the others
+        std::vector<std::size_t> order(candidates.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::stable_sort(order.begin(), order.end(),
+            [&candidates] (std::size_t i, std::size_t j) { return candidates[i].label.cost < candidates[j].label.cost; }
+        );
+
+        LblContainers<Lbl> containers;
+        for(auto i : order) { add_if_undominated(containers, candidates[i], options.cost_only_dominance, stats); }
+
+        // Containers are sorted by cost, so a beam keeps the cheapest labels
+        LblContainers<Lbl> result;
+        result.reserve(containers.size());
+        for(auto i = 0u; i < containers.size(); i++) {
+            if(containers[i].dominated) { continue; }
+            if(options.max_labels_per_vertex > 0u && result.size() == options.max_labels_per_vertex) {
+                // The remaining undominated labels do not fit in the beam
+                if(LABELLING_STATS) {
+                    stats.beam_discarded += std::count_if(containers.begin() + i, containers.end(), [] (const LblContainer<Lbl>& c) { return !c.dominated; });
+                }
+                break;
+            }
+            result.push_back(containers[i]);
         }
-    };
 
-    template<typename Lbl>
-    class VertexContainersMap {
-        std::map<Vertex, ContainersSet<Lbl>> map;
+        return result;
+    }
 
-    public:
-        using iterator = typename std::map<Vertex, ContainersSet<Lbl>>::iterator;
+    template<typename Lbl, typename LblExt>
+    std::vector<Solution> LabellingAlgorithm<Lbl, LblExt>::solve(Vertex start_v, Vertex end_v, Lbl start_label, LblExt extension, LabellingOptions options) const {
+        using Clock = std::chrono::steady_clock;
+        using Seconds = std::chrono::duration<double>;
 
-        friend auto begin(const VertexContainersMap& m) { return m.map.begin(); }
-        friend auto end(const VertexContainersMap& m) { return m.map.end(); }
+        const auto& graph = g->graph;
+        auto id = [&graph] (const Vertex& v) -> std::size_t { return graph[v]->boost_vertex_id; };
 
-        bool has_undominated_labels() const {
-            if(map.empty()) { return false; }
-            for(const auto& vs : map) { if(!vs.second.empty()) { return true; } }
-            return false;
-        }
+        // Statistics of the run. Each vertex collects its own, which are then merged under the lock.
+        LabellingStats stats;
+        std::mutex stats_mtx;
+        auto start_time = Clock::now();
+        stats.runs = 1u;
 
-        auto first_with_undominated_container() const {
-            for(auto it = map.begin(); it != map.end(); ++it) {
-                if(std::any_of(it->second.begin(), it->second.end(),
-                    [] (const auto& container) -> bool { return !container.dominated; }
-                )) { return it; }
-            }
-            return map.end();
-        }
+        // Labels at each vertex, indexed by vertex id. The labels at the end vertex are kept apart,
+        // because they are collected as soon as their predecessors are ready.
+        std::vector<LblContainers<Lbl>> labels(num_vertices(graph));
+        LblContainers<Lbl> end_labels;
 
-        const iterator begin() const { return map.begin(); }
-        const iterator end() const { return map.end(); }
-        iterator begin() { return map.begin(); }
-        iterator end() { return map.end(); }
-        auto find(const Vertex& v) const { return map.find(v); }
-        auto erase(const Vertex& v) { return map.erase(v); }
-        auto empty() const { return map.empty(); }
-        const ContainersSet<Lbl>& at(const Vertex& v) const { return map.at(v); }
-        ContainersSet<Lbl>& at(const Vertex& v) { return map.at(v); }
-        ContainersSet<Lbl>& operator[](const Vertex& v) { return map[v]; }
-    };
+        // In the beginning we only have the starting label, at the starting vertex
+        labels[id(start_v)].push_back(LblContainer<Lbl>(start_label));
 
-    template<typename Lbl>
-    bool operator==(const LblContainer<Lbl>& c1, const LblContainer<Lbl>& c2) {
-        if(c1.pred_edge != c2.pred_edge) { return false; }
-        if(c1.pred_container != c2.pred_container) { return false; }
-        return c1.label == c2.label;
-    }
+        for(const auto& level : g->topological_levels) {
+            // Pull, extend and filter the labels of the predecessors of a vertex in the current level
+            auto process_vertex = [&] (std::size_t i) {
+                Vertex cur_vertex = level[i];
 
-    template<typename Lbl, typename LblExt>
-    class LabellingAlgorithm {
-        std::shared_ptr<const Graph> g;
+                if(cur_vertex == start_v || cur_vertex == end_v) { return; }
+                if(options.cancellation.is_cancelled()) { return; }
 
-    public:
-        LabellingAlgorithm(std::shared_ptr<const Graph> g) : g{g} {}
-        std::vector<Solution> solve(Vertex start_v, Vertex end_v, Lbl start_label, LblExt extension) const;
-    };
+                LabellingStats vertex_stats;
+                LblContainers<Lbl> candidates;
+                Lbl new_label;
+                auto n_extensions = 0u;
+                auto extension_start = LABELLING_STATS ? Clock::now() : Clock::time_point();
 
-    template<typename Lbl, typename LblExt>
-    std::vector<Solution> LabellingAlgorithm<Lbl, LblExt>::solve(Vertex start_v, Vertex end_v, Lbl start_label, LblExt extension) const {
-        VertexContainersMap<Lbl> undominated;
-        VertexContainersMap<Lbl> unprocessed;
-
-        // In the beginning we only have the starting label, as an unprocessed label at the starting vertex
-        unprocessed[start_v] = { LblContainer<Lbl>(start_label, g->graph) };
-
-        // While there are unprocessed labels...
-        while(unprocessed.has_undominated_labels()) {
-            // Get the first vertex with unprocessed labels
-            auto any_set_it = unprocessed.first_with_undominated_container();
-            Vertex cur_vertex = any_set_it->first;
-            const ContainersSet<Lbl>& containers_at_cur_vertex = any_set_it->second;
-
-            // Get the first unprocessed label at the selected vertex
-            assert(containers_at_cur_vertex.has_undominated_labels());
-            auto any_cnt_it = containers_at_cur_vertex.first_undominated_container();
-
-            // Make a copy of the chosen label
-            auto cur_container = LblContainer<Lbl>(*any_cnt_it);
-
-            typename ContainersSet<Lbl>::iterator cur_inserted_it;
-            bool cur_inserted;
-
-            // Insert the current label in undominated
-            if(undominated.find(cur_vertex) == undominated.end()) { undominated[cur_vertex] = ContainersSet<Lbl>(); }
-            std::tie(cur_inserted_it, cur_inserted) = undominated.at(cur_vertex).insert(cur_container);
-            assert(!cur_inserted_it->pred_container || cur_inserted_it->pred_edge);
-
-            // Remove the label from unprocessed
-            unprocessed.at(cur_vertex).erase(any_cnt_it);
-            if(unprocessed.at(cur_vertex).empty()) { unprocessed.erase(cur_vertex); }
-
-            // Try to expand the current label along all out-edges departing from the current vertex
-            for(auto oe = out_edges(cur_vertex, g->graph); oe.first != oe.second; ++oe.first) {
-                Edge e = *oe.first;
-                Vertex dest_vertex = target(e, g->graph);
-
-                // Call to the extension function
-                auto new_label = extension(g->graph, cur_container.label, e);
-
-                // Extension didn't succeed: skip the rest
-                if(!new_label) { continue; }
-
-                // Extension succeeded! Create a container for the new label
-                auto new_container = LblContainer<Lbl>(*new_label, &(*cur_inserted_it), g->graph, e);
-                bool new_container_dominated = false;
-
-                // If there are unprocessed labels at the destination vertex,
-                // if any of them dominates the new label, then discard the new label;
-                // if the new label dominates any of them, then discard them.
-                if(unprocessed.find(dest_vertex) != unprocessed.end()) {
-                    auto dest_unp_cnt_it = unprocessed.at(dest_vertex).begin();
-
-                    while(dest_unp_cnt_it != unprocessed.at(dest_vertex).end()) {
-                        const LblContainer<Lbl>& dest_container = *dest_unp_cnt_it;
-
-                        if(new_container.label < dest_container.label && !(dest_container.label < new_container.label)) {
-                            assert(target(*new_container.pred_edge, g->graph) == target(*dest_container.pred_edge, g->graph));
-                            unprocessed.at(dest_vertex).erase(dest_unp_cnt_it++);
-                        } else if(dest_container.label < new_container.label && !(new_container.label < dest_container.label)) {
-                            assert(target(*new_container.pred_edge, g->graph) == target(*dest_container.pred_edge, g->graph));
-                            new_container_dominated = true;
-                            break;
-                        } else {
-                            ++dest_unp_cnt_it;
-                        }
+                for(auto ie = in_edges(cur_vertex, graph); ie.first != ie.second; ++ie.first) {
+                    Edge e = *ie.first;
+
+                    for(const auto& pred_container : labels[id(source(e, graph))]) {
+                        if(++n_extensions % LabellingOptions::cancellation_check_interval == 0u && options.cancellation.is_cancelled()) { return; }
+
+                        // Call to the extension function and, if it succeeded, create a container for the new label
+                        if(extension(pred_container.label, e, new_label)) { candidates.push_back(LblContainer<Lbl>(new_label, &pred_container, e)); }
                     }
+                }
 
-                    if(unprocessed.at(dest_vertex).empty()) { unprocessed.erase(dest_vertex); }
-                    if(new_container_dominated) { continue; }
+                auto dominance_start = LABELLING_STATS ? Clock::now() : Clock::time_point();
+                auto& cur_labels = labels[id(cur_vertex)];
+
+                cur_labels = undominated(candidates, options, vertex_stats);
+
+                if(LABELLING_STATS) {
+                    vertex_stats.labels_extended = n_extensions;
+                    vertex_stats.labels_created = candidates.size();
+                    vertex_stats.labels_infeasible = n_extensions - candidates.size();
+                    vertex_stats.labels_kept = cur_labels.size();
+                    vertex_stats.vertices_processed = 1u;
+                    vertex_stats.max_labels_per_vertex = cur_labels.size();
+                    vertex_stats.peak_label_bytes = candidates.size() * sizeof(LblContainer<Lbl>);
+                    vertex_stats.extension_time = Seconds(dominance_start - extension_start).count();
+                    vertex_stats.dominance_time = Seconds(Clock::now() - dominance_start).count();
+
+                    std::lock_guard<std::mutex> guard(stats_mtx);
+                    stats.add(vertex_stats);
                 }
+            };
+
+            if(pool) {
+                pool->parallel_for(level.size(), process_vertex);
+            } else {
+                for(auto i = 0u; i < level.size(); i++) { process_vertex(i); }
+            }
+
+            // The labels in this level are final: extend them to the end vertex
+            auto end_vertex_start = LABELLING_STATS ? Clock::now() : Clock::time_point();
 
-                // If there are undominated labels at the destination vertex,
-                // if any of them dominates the new label, then discard the new label;
-                // if the new label dominates any of them, then discard them.
-                if(undominated.find(dest_vertex) != undominated.end()) {
-                    auto dest_und_cnt_it = undominated.at(dest_vertex).begin();
-
-                    while(dest_und_cnt_it != undominated.at(dest_vertex).end()) {
-                        const LblContainer<Lbl>& dest_container = *dest_und_cnt_it;
-
-                        if(!dest_container.dominated && new_container.label < dest_container.label && !(dest_container.label < new_container.label)) {
-                            assert(target(*new_container.pred_edge, g->graph) == target(*dest_container.pred_edge, g->graph));
-                            undominated.at(dest_vertex).mark_dominated(dest_und_cnt_it++);
-                        } else if(!dest_container.dominated && dest_container.label < new_container.label && !(new_container.label < dest_container.label)) {
-                            assert(target(*new_container.pred_edge, g->graph) == target(*dest_container.pred_edge, g->graph));
-                            new_container_dominated = true;
-                            break;
-                        } else {
-                            ++dest_und_cnt_it;
+            for(const auto& cur_vertex : level) {
+                for(auto oe = out_edges(cur_vertex, graph); oe.first != oe.second; ++oe.first) {
+                    Edge e = *oe.first;
+
+                    if(target(e, graph) != end_v) { continue; }
+
+                    Lbl new_label;
+                    for(const auto& cur_container : labels[id(cur_vertex)]) {
+                        if(LABELLING_STATS) { ++stats.labels_extended; }
+
+                        if(extension(cur_container.label, e, new_label)) {
+                            if(LABELLING_STATS) { ++stats.labels_created; }
+                            add_if_undominated(end_labels, LblContainer<Lbl>(new_label, &cur_container, e), false, stats);
+                        } else if(LABELLING_STATS) {
+                            ++stats.labels_infeasible;
                         }
                     }
-
-                    if(undominated.at(dest_vertex).empty()) { undominated.erase(dest_vertex); }
-                    if(new_container_dominated) { continue; }
                 }
+            }
 
-                typename ContainersSet<Lbl>::iterator new_inserted_it;
-                bool new_inserted;
+            if(LABELLING_STATS) { stats.end_vertex_time += Seconds(Clock::now() - end_vertex_start).count(); }
 
-                // If we arrived up to here, it means that the new label is not dominated
-                // by any existing label at the destination vertex, so we can place it in
-                // the set of unprocessed labels at the destination vertex.
-                if(unprocessed.find(dest_vertex) == unprocessed.end()) { unprocessed[dest_vertex] = ContainersSet<Lbl>(); }
-                std::tie(new_inserted_it, new_inserted) = unprocessed.at(dest_vertex).insert(new_container);
+            // If we have a column budget, check whether we already have enough negative enough
+            // labels at the end vertex, to stop without exhausting all labels.
+            if(options.max_columns > 0u) {
+                auto negative_labels = std::count_if(end_labels.begin(), end_labels.end(),
+                    [&options] (const LblContainer<Lbl>& c) { return !c.dominated && c.label.cost < options.rc_threshold; }
+                );
 
-                assert(new_inserted_it->pred_container);
-                assert(new_inserted_it->pred_edge);
+                if((unsigned int) negative_labels >= options.max_columns) { break; }
             }
+
+            // If we were asked to stop, return the labels we already have at the end vertex
+            if(options.cancellation.is_cancelled()) { break; }
         }
 
-        // If there was no path leading to the end vertex, return an empty set of solutions
-        if(undominated.find(end_v) == undominated.end()) { return std::vector<Solution>(); }
+        auto path_start = LABELLING_STATS ? Clock::now() : Clock::time_point();
 
         // We now get the undominated labels at the end vertex
-        const ContainersSet<Lbl>& pareto_optimal_containers = undominated.at(end_v);
+        std::vector<const LblContainer<Lbl>*> pareto_optimal_containers;
+
+        for(const auto& oc : end_labels) {
+            if(!oc.dominated) { pareto_optimal_containers.push_back(&oc); }
+        }
+
+        // If there is a column budget, only keep the labels with the most negative cost
+        if(options.max_columns > 0u && pareto_optimal_containers.size() > options.max_columns) {
+            std::partial_sort(
+                pareto_optimal_containers.begin(),
+                pareto_optimal_containers.begin() + options.max_columns,
+                pareto_optimal_containers.end(),
+                [] (const LblContainer<Lbl>* c1, const LblContainer<Lbl>* c2) { return c1->label.cost < c2->label.cost; }
+            );
+            pareto_optimal_containers.resize(options.max_columns);
+        }
+
         std::vector<Solution> pareto_optimal_solutions;
         pareto_optimal_solutions.reserve(pareto_optimal_containers.size());
 
         // And, for each of them, we reconstruct the corresponding optimal path
         for(const auto& oc : pareto_optimal_containers) {
             Path p;
-            double reduced_cost = 0;
-            const LblContainer<Lbl>* current = &oc;
+            const LblContainer<Lbl>* current = oc;
 
             while(current->pred_container != nullptr) {
                 p.push_back(*current->pred_edge);
-                reduced_cost += current->label.cost;
-
-                if(current->pred_container->pred_container == nullptr) { reduced_cost += current->pred_container->label.cost; }
-
                 current = current->pred_container;
             }
 
-            // And we add it to the set of solutions to return
-            pareto_optimal_solutions.emplace_back(p, reduced_cost, g);
+            // The cost of the label at the end vertex is the reduced cost of the whole path
+            pareto_optimal_solutions.emplace_back(p, oc->label.cost, g);
+        }
+
+        if(LABELLING_STATS && options.stats) {
+            // Labels are kept until the end of the run, so the peak is reached when the largest
+            // set of candidates at a vertex is alive together with (almost) all the labels
+            stats.peak_label_bytes += (stats.labels_kept + end_labels.size()) * sizeof(LblContainer<Lbl>);
+            stats.path_time = Seconds(Clock::now() - path_start).count();
+            stats.total_time = Seconds(Clock::now() - start_time).count();
+            options.stats->add(stats);
         }
 
         return pareto_optimal_solutions;
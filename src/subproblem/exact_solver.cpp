@@ -7,9 +7,10 @@
 #include "exact_solver.h"
 // #include "labelling.h"
 #include "_labelling.h"
+#include "pulse_algorithm.h"
 
 namespace mvrp {
-    std::vector<Solution> ExactSolver::solve(double &time_spent) {
+    std::vector<Solution> ExactSolver::solve(double &time_spent, bool prove_optimality) {
         // std::vector<Solution> sols;
         //
         // std::vector<Path> optimal_paths;
@@ -56,9 +57,21 @@ namespace mvrp {
         // return sols;
 
         auto vc = g->vessel_class;
-        LabelExtender extender(erased);
-        LabellingAlgorithm<Label, LabelExtender> alg(g);
+        LabelExtender extender(*g, erased);
+        LabellingOptions options(0u, 0.0, 0u, false, cancellation, stats);
 
-        return alg.solve(g->get_source_vertex().second, g->get_sink_vertex().second, Label(*g), extender);
+        if(!prove_optimality) {
+            options = LabellingOptions(prob->params.exact_pricing_max_columns, prob->params.exact_pricing_rc_threshold, 0u, false, cancellation, stats);
+        }
+
+        // Same labels as the labelling, so that an empty result proves that there is no negative reduced cost column
+        if(prob->params.exact_pricing_engine == PricingEngine::PULSE) {
+            PulseAlgorithm alg(g, prob->pricing_pool.get());
+            return alg.solve(g->get_source_vertex().second, g->get_sink_vertex().second, Label::initial(g->vessel_class->capacity), extender, options);
+        }
+
+        LabellingAlgorithm<Label, LabelExtender> alg(g, prob->pricing_pool.get());
+
+        return alg.solve(g->get_source_vertex().second, g->get_sink_vertex().second, Label::initial(g->vessel_class->capacity), extender, options);
     }
 }
\ No newline at end of file
@@ -8,17 +8,31 @@
 #include <memory>
 #include <vector>
 
+#include "../base/cancellation.h"
 #include "../base/graph.h"
+#include "../base/problem.h"
 #include "../column/solution.h"
+#include "labelling_stats.h"
 
 namespace mvrp {
     struct ExactSolver {
+        std::shared_ptr<const Problem> prob;
         std::shared_ptr<const Graph> g;
         const ErasedEdges &erased;
 
-        ExactSolver(std::shared_ptr<const Graph> g, const ErasedEdges &erased) : g(g), erased{erased} {}
+        /* When cancelled, the solver stops and returns the columns found so far. */
+        CancellationToken cancellation;
 
-        std::vector<Solution> solve(double &time_spent);
+        /* If not null, the statistics of the labelling algorithm are added to it. */
+        LabellingStats *stats;
+
+        ExactSolver(std::shared_ptr<const Problem> prob, std::shared_ptr<const Graph> g, const ErasedEdges &erased, CancellationToken cancellation = CancellationToken(), LabellingStats *stats = nullptr) :
+            prob(prob), g(g), erased{erased}, cancellation{cancellation}, stats{stats} {}
+
+        /* If prove_optimality is false, the labelling stops as soon as it finds exact_pricing_max_columns
+         * columns with reduced cost below exact_pricing_rc_threshold. Otherwise it runs to completion, so
+         * that if it returns no negative column, we are sure that none exists. */
+        std::vector<Solution> solve(double &time_spent, bool prove_optimality = false);
     };
 }
 
@@ -3,73 +3,98 @@
 //
 
 #include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <limits>
 #include <list>
+#include <tuple>
 #include <vector>
 
+#include <boost/optional.hpp>
+
 #include "heuristics_solver.h"
 // #include "labelling.h"
 #include "_labelling.h"
+#include "pulse_algorithm.h"
 
 namespace mvrp {
-    std::vector<Solution> HeuristicsSolver::solve_fast_forward() const {
-        auto sols = std::vector<Solution>();
+    TaskRng HeuristicsSolver::rng(RandomTask task, unsigned int rerun) const {
+        const auto &vcs = prob->data.vessel_classes;
+        auto vc_index = std::distance(vcs.begin(), std::find(vcs.begin(), vcs.end(), g->vessel_class));
+
+        return TaskRng(prob->params.random_seed, node_number, vc_index, (static_cast<std::uint64_t>(task) << 32u) | rerun);
+    }
+
+    std::vector<char> HeuristicsSolver::erased_edge_flags() const {
+        auto erased_edge = std::vector<char>(num_edges(g->graph), 0);
+
+        for(const auto &ee : erased) {
+            for(const auto &e : ee.second) { erased_edge[g->graph[e]->boost_edge_id] = 1; }
+        }
+
+        return erased_edge;
+    }
+
+    std::vector<Solution> HeuristicsSolver::solve_fast_forward(const std::vector<char> &erased_edge) const {
         auto h1 = g->get_source_vertex().second;
         auto h2 = g->get_sink_vertex().second;
-        struct EdgeWithCost {
-            Edge e;
-            double c;
-            double rc;
-        };
+        const auto &graph = g->graph;
+        auto rerun_sols = std::vector<boost::optional<Solution>>(std::max(prob->params.greedy_reruns, 0));
 
-        for(auto i = 0; i < prob->params.greedy_reruns; i++) {
+        assert(g->sorted_out_edges.size() == num_vertices(graph));
+
+        auto rerun = [&] (std::size_t i) {
+            if(cancellation.is_cancelled()) { return; }
+
+            auto random = rng(RandomTask::FAST_FORWARD, i);
+            auto visited = std::vector<bool>(g->n_ports, false);
+            auto out_e = std::vector<Edge>();
             auto current = h1;
             auto path = Path();
             auto tot_c = 0.0f, tot_rc = 0.0f;
             auto done = false;
 
+            // Capacity is tracked as in the labelling algorithm
+            int pic = g->vessel_class->capacity, del = g->vessel_class->capacity;
+
             while(current != h2) {
-                std::vector<EdgeWithCost> out_e;
+                out_e.clear();
 
-                for(auto ep = out_edges(current, g->graph); ep.first != ep.second; ++ep.first) {
-                    if(erased.find(current) != erased.end() &&
-                       erased.at(current).find(*ep.first) != erased.at(current).end()) { continue; }
+                // Edges are sorted, so the candidates are the first greedy_max_outarcs usable ones
+                for(const auto &e : g->sorted_out_edges[graph[current]->boost_vertex_id]) {
+                    if((int) out_e.size() == prob->params.greedy_max_outarcs) { break; }
+                    if(erased_edge[graph[e]->boost_edge_id]) { continue; }
 
-                    auto n_dest = *g->graph[target(*ep.first, g->graph)];
+                    const Node &n_dest = *graph[target(e, graph)];
+                    auto port = g->port_index[n_dest.boost_vertex_id];
 
-                    auto dual = g->dual_of(n_dest);
-                    EdgeWithCost ewc = {*ep.first, g->graph[*ep.first]->cost, g->graph[*ep.first]->cost - dual};
+                    // Closes a cycle
+                    if(port >= 0 && visited[port]) { continue; }
 
-                    auto closes_cycle = false;
-                    for(const auto &e : path) {
-                        if(n_dest.n_type == NodeType::REGULAR_PORT &&
-                           n_dest.port == g->graph[source(e, g->graph)]->port) {
-                            closes_cycle = true;
-                            break;
-                        }
-                    }
+                    // Not enough capacity
+                    if(pic < n_dest.pu_demand() || del < n_dest.de_demand()) { continue; }
 
-                    if(!closes_cycle) {
-                        out_e.push_back(ewc);
-                    }
+                    out_e.push_back(e);
                 }
 
                 if(out_e.size() == 0) {
                     break;
                 }
 
-                std::sort(out_e.begin(), out_e.end(),
-                          [this](const auto &ewc1, const auto &ewc2) {
-                              return (ewc1.rc > ewc2.rc);
-                          });
+                auto chosen = out_e[random.below(out_e.size())];
+                const Node &n_dest = *graph[target(chosen, graph)];
+                auto port = g->port_index[graph[current]->boost_vertex_id];
 
-                auto rnd_idx = (int) (rand() % (std::min(prob->params.greedy_max_outarcs, (int) out_e.size())));
-                auto chosen = out_e[rnd_idx];
+                if(port >= 0) { visited[port] = true; }
 
-                path.insert(path.begin(), chosen.e);
-                tot_c += chosen.c;
-                tot_rc += chosen.rc;
+                del = std::min(pic - n_dest.pu_demand(), del - n_dest.de_demand());
+                pic = pic - n_dest.pu_demand();
 
-                current = target(chosen.e, g->graph);
+                path.insert(path.begin(), chosen);
+                tot_c += graph[chosen]->cost;
+                tot_rc += graph[chosen]->cost - g->dual_of(n_dest);
+
+                current = target(chosen, graph);
 
                 if(current == h2) {
                     done = true;
@@ -77,73 +102,78 @@ namespace mvrp {
             }
 
             if(done) {
-                sols.push_back(Solution(path, tot_c, tot_rc, g->vessel_class, g));
+                rerun_sols[i] = Solution(path, tot_c, tot_rc, g->vessel_class, g);
             }
-        }
+        };
+
+        // Each rerun has its own random stream, so the result does not depend on the number of threads
+        prob->pricing_pool->parallel_for(rerun_sols.size(), rerun);
+
+        auto sols = std::vector<Solution>();
+        for(const auto &s : rerun_sols) { if(s) { sols.push_back(*s); } }
 
         return sols;
     }
 
-    std::vector<Solution> HeuristicsSolver::solve_fast_backward() const {
-        std::vector<Solution> sols;
+    std::vector<Solution> HeuristicsSolver::solve_fast_backward(const std::vector<char> &erased_edge) const {
         auto h1 = g->get_source_vertex().second;
         auto h2 = g->get_sink_vertex().second;
-        struct EdgeWithCost {
-            Edge e;
-            double c;
-            double rc;
-        };
+        const auto &graph = g->graph;
+        auto rerun_sols = std::vector<boost::optional<Solution>>(std::max(prob->params.greedy_reruns, 0));
+
+        assert(g->sorted_in_edges.size() == num_vertices(graph));
+
+        auto rerun = [&] (std::size_t i) {
+            if(cancellation.is_cancelled()) { return; }
 
-        for(int i = 0; i < prob->params.greedy_reruns; i++) {
+            auto random = rng(RandomTask::FAST_BACKWARD, i);
+            auto visited = std::vector<bool>(g->n_ports, false);
+            auto in_e = std::vector<Edge>();
             auto current = h2;
             Path path;
             auto tot_c = 0.0f, tot_rc = 0.0f;
             auto done = false;
 
+            // Going backwards, deliveries play the role of pickups and vice versa
+            int pic = g->vessel_class->capacity, del = g->vessel_class->capacity;
+
             while(current != h1) {
-                std::vector<EdgeWithCost> in_e;
+                in_e.clear();
 
-                for(auto ep = in_edges(current, g->graph); ep.first != ep.second; ++ep.first) {
-                    auto v_orig = source(*ep.first, g->graph);
+                for(const auto &e : g->sorted_in_edges[graph[current]->boost_vertex_id]) {
+                    if((int) in_e.size() == prob->params.greedy_max_outarcs) { break; }
+                    if(erased_edge[graph[e]->boost_edge_id]) { continue; }
 
-                    if(erased.find(v_orig) != erased.end() &&
-                       erased.at(v_orig).find(*ep.first) != erased.at(v_orig).end()) { continue; }
+                    const Node &n_orig = *graph[source(e, graph)];
+                    auto port = g->port_index[n_orig.boost_vertex_id];
 
-                    auto n_orig = *g->graph[v_orig];
-                    auto dual = g->dual_of(n_orig);
-                    EdgeWithCost ewc = {*ep.first, g->graph[*ep.first]->cost, g->graph[*ep.first]->cost - dual};
+                    // Closes a cycle
+                    if(port >= 0 && visited[port]) { continue; }
 
-                    auto closes_cycle = false;
-                    for(const auto &e : path) {
-                        if(n_orig.n_type == NodeType::REGULAR_PORT &&
-                           n_orig.port == g->graph[target(e, g->graph)]->port) {
-                            closes_cycle = true;
-                            break;
-                        }
-                    }
+                    // Not enough capacity
+                    if(pic < n_orig.pu_demand() || del < n_orig.de_demand()) { continue; }
 
-                    if(!closes_cycle) {
-                        in_e.push_back(ewc);
-                    }
+                    in_e.push_back(e);
                 }
 
                 if(in_e.size() == 0) {
                     break;
                 }
 
-                std::sort(in_e.begin(), in_e.end(),
-                          [this](const auto &ewc1, const auto &ewc2) {
-                              return (ewc1.rc > ewc2.rc);
-                          });
+                auto chosen = in_e[random.below(in_e.size())];
+                const Node &n_orig = *graph[source(chosen, graph)];
+                auto port = g->port_index[graph[current]->boost_vertex_id];
 
-                auto rnd_idx = (int) (rand() % (std::min(prob->params.greedy_max_outarcs, (int) in_e.size())));
-                auto chosen = in_e[rnd_idx];
+                if(port >= 0) { visited[port] = true; }
 
-                path.push_back(chosen.e);
-                tot_c += chosen.c;
-                tot_rc += chosen.rc;
+                pic = std::min(del - n_orig.de_demand(), pic - n_orig.pu_demand());
+                del = del - n_orig.de_demand();
 
-                current = source(chosen.e, g->graph);
+                path.push_back(chosen);
+                tot_c += graph[chosen]->cost;
+                tot_rc += graph[chosen]->cost - g->dual_of(n_orig);
+
+                current = source(chosen, graph);
 
                 if(current == h1) {
                     done = true;
@@ -151,16 +181,22 @@ namespace mvrp {
             }
 
             if(done) {
-                sols.push_back(Solution(path, tot_c, tot_rc, g->vessel_class, g));
+                rerun_sols[i] = Solution(path, tot_c, tot_rc, g->vessel_class, g);
             }
-        }
+        };
+
+        prob->pricing_pool->parallel_for(rerun_sols.size(), rerun);
+
+        auto sols = std::vector<Solution>();
+        for(const auto &s : rerun_sols) { if(s) { sols.push_back(*s); } }
 
         return sols;
     }
 
     std::vector<Solution> HeuristicsSolver::solve_fast() const {
-        std::vector<Solution> fast_fwd_sols = solve_fast_forward();
-        std::vector<Solution> fast_bwd_sols = solve_fast_backward();
+        auto erased_edge = erased_edge_flags();
+        std::vector<Solution> fast_fwd_sols = solve_fast_forward(erased_edge);
+        std::vector<Solution> fast_bwd_sols = solve_fast_backward(erased_edge);
 
         fast_fwd_sols.insert(fast_fwd_sols.end(), fast_bwd_sols.begin(), fast_bwd_sols.end());
 
@@ -169,7 +205,7 @@ namespace mvrp {
 
     std::vector<Solution> HeuristicsSolver::solve_elem_on_generic_graph(bool smart) const {
         // std::vector<Solution> sols;
-        auto local_erased = smart ? g->smart_reduce_graph(0, prob->params.p_acceleration_max_arcs_share, erased)
+        auto local_erased = smart ? g->smart_reduce_graph(0, prob->params.p_acceleration_max_arcs_share, erased, rng(RandomTask::SMART_REDUCTION))
                                   : g->reduce_graph(prob->params.cp_acceleration_arcs_share, erased);        
         //
         // std::vector<Path> optimal_paths;
@@ -208,14 +244,85 @@ namespace mvrp {
         //
         // return sols;
 
-        LabelExtender extender(local_erased);
-        LabellingAlgorithm<ElementaryLabel, LabelExtender> alg(g);
-        return alg.solve(g->get_source_vertex().second, g->get_sink_vertex().second, ElementaryLabel(*g, prob->data.get_ports_list()), extender);
+        LabellingOptions options(0u, 0.0, 0u, false, cancellation, stats);
+
+        if(prob->params.elementary_pricing_engine == PricingEngine::PULSE) {
+            // Without dominance, the pulse would enumerate all negative elementary routes: it only keeps the best ones
+            auto pulse_options = LabellingOptions(prob->params.exact_pricing_max_columns, std::numeric_limits<double>::lowest(), 0u, false, cancellation, stats);
+            LabelExtender extender(*g, local_erased);
+            PulseAlgorithm alg(g, prob->pricing_pool.get());
+            return alg.solve(g->get_source_vertex().second, g->get_sink_vertex().second, ElementaryLabel::initial(g->vessel_class->capacity), extender, pulse_options);
+        }
+
+        LabellingAlgorithm<ElementaryLabel, LabelExtender> alg(g, prob->pricing_pool.get());
+
+        if(!prob->params.dssr_elementary_labelling || !critical_ports) {
+            LabelExtender extender(*g, local_erased);
+            return alg.solve(g->get_source_vertex().second, g->get_sink_vertex().second, ElementaryLabel::initial(g->vessel_class->capacity), extender, options);
+        }
+
+        // Decremental state-space relaxation: we only enforce elementarity on the critical ports and, as
+        // long as the best routes visit some port more than once, we add such ports to the critical ones.
+        while(true) {
+            LabelExtender extender(*g, local_erased, critical_ports);
+            auto sols = alg.solve(g->get_source_vertex().second, g->get_sink_vertex().second, ElementaryLabel::initial(g->vessel_class->capacity), extender, options);
+            auto elementary_sols = std::vector<Solution>();
+            auto new_critical_ports = false;
+
+            for(const auto &s : sols) {
+                auto repeated = s.repeated_ports();
+
+                if(repeated.empty()) {
+                    elementary_sols.push_back(s);
+                    continue;
+                }
+
+                // Non-elementary routes with positive reduced cost would be discarded anyway
+                if(s.reduced_cost > 0.0) { continue; }
+
+                for(const auto &pt : repeated) {
+                    if(std::find(critical_ports->begin(), critical_ports->end(), pt) == critical_ports->end()) {
+                        critical_ports->push_back(pt);
+                        new_critical_ports = true;
+                    }
+                }
+            }
+
+            if(!new_critical_ports || cancellation.is_cancelled()) { return elementary_sols; }
+
+            if(PEDANTIC) {
+                std::cerr << "\t\t\tDSSR: " << critical_ports->size() << " critical ports for " << g->vessel_class->name << std::endl;
+            }
+        }
+    }
+
+    std::vector<Solution> HeuristicsSolver::solve_on_sparse_graph() const {
+        auto local_erased = g->sparsify_graph(prob->params.sparse_pricing_out_arcs, erased, prob->pricing_pool.get());
+
+        LabelExtender extender(*g, local_erased);
+        LabellingAlgorithm<Label, LabelExtender> alg(g, prob->pricing_pool.get());
+        LabellingOptions options(0u, 0.0, 0u, false, cancellation, stats);
+        return alg.solve(g->get_source_vertex().second, g->get_sink_vertex().second, Label::initial(g->vessel_class->capacity), extender, options);
+    }
+
+    std::vector<Solution> HeuristicsSolver::solve_beam() const {
+        LabelExtender extender(*g, erased);
+        LabellingAlgorithm<Label, LabelExtender> alg(g, prob->pricing_pool.get());
+        LabellingOptions options(
+            prob->params.exact_pricing_max_columns,
+            prob->params.exact_pricing_rc_threshold,
+            prob->params.beam_labelling_width,
+            prob->params.beam_labelling_cost_only_dominance,
+            cancellation,
+            stats
+        );
+
+        return alg.solve(g->get_source_vertex().second, g->get_sink_vertex().second, Label::initial(g->vessel_class->capacity), extender, options);
     }
 
     std::vector<Solution> HeuristicsSolver::solve_on_generic_graph(bool smart) const {
         // std::vector<Solution> sols;
-        auto local_erased = smart ? g->smart_reduce_graph(0, prob->params.p_acceleration_max_arcs_share, erased)
+        auto local_erased = smart ? g->smart_reduce_graph(0, prob->params.p_acceleration_max_arcs_share, erased, rng(RandomTask::SMART_REDUCTION))
                                   : g->reduce_graph(prob->params.cp_acceleration_arcs_share, erased);
         //
         // std::vector<Path> optimal_paths;
@@ -253,8 +360,142 @@ namespace mvrp {
         //
         // return sols;
 
-        LabelExtender extender(local_erased);
-        LabellingAlgorithm<Label, LabelExtender> alg(g);
-        return alg.solve(g->get_source_vertex().second, g->get_sink_vertex().second, Label(*g), extender);
+        LabelExtender extender(*g, local_erased);
+        LabellingAlgorithm<Label, LabelExtender> alg(g, prob->pricing_pool.get());
+        LabellingOptions options(0u, 0.0, 0u, false, cancellation, stats);
+        return alg.solve(g->get_source_vertex().second, g->get_sink_vertex().second, Label::initial(g->vessel_class->capacity), extender, options);
+    }
+
+    boost::optional<Edge> HeuristicsSolver::usable_edge(const LabelExtender &extender, Vertex u, Vertex v) const {
+        bool found;
+        Edge e;
+        std::tie(e, found) = edge(u, v, g->graph);
+
+        if(!found || extender.is_erased(e)) { return boost::none; }
+        return e;
+    }
+
+    boost::optional<double> HeuristicsSolver::route_reduced_cost(const LabelExtender &extender, const std::vector<Edge> &route) const {
+        auto label = Label::initial(g->vessel_class->capacity);
+        Label new_label;
+
+        for(const auto &e : route) {
+            if(!extender(label, e, new_label)) { return boost::none; }
+            label = new_label;
+        }
+
+        return label.cost;
+    }
+
+    boost::optional<HeuristicsSolver::LocalSearchMove> HeuristicsSolver::best_move(const LabelExtender &extender, const std::vector<Edge> &route) const {
+        const auto &graph = g->graph;
+        auto n = route.size();
+        boost::optional<LocalSearchMove> best;
+
+        // Vertices visited by the route, from the source to the sink
+        auto vs = std::vector<Vertex>();
+        vs.push_back(source(route.front(), graph));
+        for(const auto &e : route) { vs.push_back(target(e, graph)); }
+
+        // Which (port, pickup/delivery) pairs the route already visits
+        auto slot = [this, &graph] (Vertex v) { return 2 * g->port_index[graph[v]->boost_vertex_id] + (graph[v]->pu_type == PortType::DELIVERY ? 1 : 0); };
+        auto visited = std::vector<bool>(2 * g->n_ports, false);
+        for(const auto &v : vs) { if(graph[v]->n_type == NodeType::REGULAR_PORT) { visited[slot(v)] = true; } }
+
+        auto is_regular = [&graph] (Vertex v) { return graph[v]->n_type == NodeType::REGULAR_PORT; };
+
+        // Keeps the move if it is the best so far and the resulting route is feasible
+        auto consider = [&] (std::size_t i, std::size_t j, std::vector<Edge> new_edges) {
+            auto delta = 0.0;
+            for(const auto &e : new_edges) { delta += extender.reduced_cost(e); }
+            for(auto k = i; k < j; k++) { delta -= extender.reduced_cost(route[k]); }
+
+            if(delta > -Label::EPS || (best && delta >= best->delta)) { return; }
+
+            auto new_route = std::vector<Edge>(route.begin(), route.begin() + i);
+            new_route.insert(new_route.end(), new_edges.begin(), new_edges.end());
+            new_route.insert(new_route.end(), route.begin() + j, route.end());
+
+            if(!route_reduced_cost(extender, new_route)) { return; }
+
+            best = LocalSearchMove{i, j, new_edges, delta};
+        };
+
+        for(auto i = 0u; i < n; i++) {
+            for(auto oe = out_edges(vs[i], graph); oe.first != oe.second; ++oe.first) {
+                auto e1 = *oe.first;
+                auto w = target(e1, graph);
+
+                if(extender.is_erased(e1)) { continue; }
+
+                // Change the speed of leg i: another edge between the same vertices
+                if(w == vs[i + 1]) {
+                    if(e1 != route[i]) { consider(i, i + 1, {e1}); }
+                    continue;
+                }
+
+                if(!is_regular(w)) { continue; }
+
+                // Insert a call between vs[i] and vs[i + 1]
+                if(!visited[slot(w)]) {
+                    if(auto e2 = usable_edge(extender, w, vs[i + 1])) { consider(i, i + 1, {e1, *e2}); }
+                }
+
+                if(i + 2 > n) { continue; }
+
+                // Replace the call at vs[i + 1], or shift it in time (which changes the speed of the legs before and after it)
+                if(!visited[slot(w)] || graph[w]->same_row_as(*graph[vs[i + 1]])) {
+                    if(auto e2 = usable_edge(extender, w, vs[i + 2])) { consider(i, i + 2, {e1, *e2}); }
+                }
+
+                if(i + 3 > n || !is_regular(vs[i + 1]) || !graph[w]->same_row_as(*graph[vs[i + 2]])) { continue; }
+
+                // Swap the calls at vs[i + 1] and vs[i + 2]
+                for(auto oe2 = out_edges(w, graph); oe2.first != oe2.second; ++oe2.first) {
+                    auto x = target(*oe2.first, graph);
+
+                    if(extender.is_erased(*oe2.first) || !graph[x]->same_row_as(*graph[vs[i + 1]])) { continue; }
+                    if(auto e3 = usable_edge(extender, x, vs[i + 3])) { consider(i, i + 3, {e1, *oe2.first, *e3}); }
+                }
+            }
+
+            // Remove the call at vs[i + 1]
+            if(i + 2 <= n && is_regular(vs[i + 1])) {
+                if(auto e = usable_edge(extender, vs[i], vs[i + 2])) { consider(i, i + 2, {*e}); }
+            }
+        }
+
+        return best;
+    }
+
+    std::vector<Solution> HeuristicsSolver::solve_local_search(const std::vector<Solution> &seeds) const {
+        LabelExtender extender(*g, erased);
+        auto sols = std::vector<Solution>();
+
+        for(const auto &seed : seeds) {
+            if(seed.g != g || seed.path.empty()) { continue; }
+
+            // Paths are stored from the last edge to the first one
+            auto route = std::vector<Edge>(seed.path.rbegin(), seed.path.rend());
+
+            if(!route_reduced_cost(extender, route)) { continue; }
+
+            // Best-improvement descent: each move strictly decreases the reduced cost, so it terminates
+            while(!cancellation.is_cancelled()) {
+                auto move = best_move(extender, route);
+
+                if(!move) { break; }
+
+                auto new_route = std::vector<Edge>(route.begin(), route.begin() + move->i);
+                new_route.insert(new_route.end(), move->new_edges.begin(), move->new_edges.end());
+                new_route.insert(new_route.end(), route.begin() + move->j, route.end());
+                route = new_route;
+
+                auto rc = *route_reduced_cost(extender, route);
+                if(rc < 0.0) { sols.emplace_back(Path(route.rbegin(), route.rend()), rc, g); }
+            }
+        }
+
+        return sols;
     }
 }
@@ -5,12 +5,21 @@
 #ifndef HEURISTICS_SOLVER_H
 #define HEURISTICS_SOLVER_H
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <vector>
 
+#include <boost/optional.hpp>
+
+#include "../base/cancellation.h"
 #include "../base/graph.h"
 #include "../base/problem.h"
+#include "../base/task_rng.h"
 #include "../column/solution.h"
 #include "../preprocessing/program_params.h"
+#include "_labelling.h"
+#include "labelling_stats.h"
 
 namespace mvrp {
     struct HeuristicsSolver {
@@ -18,7 +27,21 @@ namespace mvrp {
         std::shared_ptr<const Graph> g;
         const ErasedEdges &erased;
 
-        HeuristicsSolver(std::shared_ptr<const Problem> prob, std::shared_ptr<const Graph> g, const ErasedEdges &erased) : prob(prob), g(g), erased{erased} {}
+        /* Critical ports for the DSSR elementary labelling. They are updated by the elementary
+         * labelling algorithms, so that they can be reused at the next CG iteration. */
+        VisitablePorts *critical_ports;
+
+        /* When cancelled, the heuristics stop and return the columns found so far. */
+        CancellationToken cancellation;
+
+        /* If not null, the statistics of the labelling algorithms are added to it. */
+        LabellingStats *stats;
+
+        /* Number of the B&B node: together with the run seed, it determines the random choices. */
+        unsigned int node_number;
+
+        HeuristicsSolver(std::shared_ptr<const Problem> prob, std::shared_ptr<const Graph> g, const ErasedEdges &erased, VisitablePorts *critical_ports = nullptr, CancellationToken cancellation = CancellationToken(), LabellingStats *stats = nullptr, unsigned int node_number = 0u) :
+            prob(prob), g(g), erased{erased}, critical_ports{critical_ports}, cancellation{cancellation}, stats{stats}, node_number{node_number} {}
 
         std::vector<Solution> solve_fast() const;
         std::vector<Solution> solve_elem_on_reduced_graph() const { return solve_elem_on_generic_graph(false); }
@@ -26,9 +49,43 @@ namespace mvrp {
         std::vector<Solution> solve_elem_on_smart_graph() const { return solve_elem_on_generic_graph(true); }
         std::vector<Solution> solve_on_smart_graph() const { return solve_on_generic_graph(true); }
 
+        /* Labelling on the graph where only the sparse_pricing_out_arcs arcs with the lowest reduced cost are kept out of each vertex */
+        std::vector<Solution> solve_on_sparse_graph() const;
+
+        /* Labelling on the complete graph, keeping at most beam_labelling_width labels per vertex */
+        std::vector<Solution> solve_beam() const;
+
+        /* Local search starting from the given routes (only those on this graph are used). Moves: insert, remove
+         * or replace a port call, swap two consecutive calls, change the speed of a leg, shift a call in time.
+         * Returns the negative reduced cost routes found while descending towards a local optimum. */
+        std::vector<Solution> solve_local_search(const std::vector<Solution> &seeds) const;
+
     private:
-        std::vector<Solution> solve_fast_forward() const;
-        std::vector<Solution> solve_fast_backward() const;
+        /* A local search move: edges route[i], ..., route[j - 1] are replaced by new_edges */
+        struct LocalSearchMove {
+            std::size_t i, j;
+            std::vector<Edge> new_edges;
+            double delta;
+        };
+
+        boost::optional<Edge> usable_edge(const LabelExtender &extender, Vertex u, Vertex v) const;
+        boost::optional<double> route_reduced_cost(const LabelExtender &extender, const std::vector<Edge> &route) const;
+        boost::optional<LocalSearchMove> best_move(const LabelExtender &extender, const std::vector<Edge> &route) const;
+
+        /* Tasks which need random numbers: each of them gets its own stream */
+        enum class RandomTask : std::uint64_t {
+            FAST_FORWARD, FAST_BACKWARD, SMART_REDUCTION
+        };
+
+        /* Random number generator for the given task (and rerun of the task) */
+        TaskRng rng(RandomTask task, unsigned int rerun = 0u) const;
+
+        /* Flags of the erased edges, by edge id */
+        std::vector<char> erased_edge_flags() const;
+
+        /* Greedy heuristics, which use the graph's sorted adjacency lists: they must be up to date with the duals */
+        std::vector<Solution> solve_fast_forward(const std::vector<char> &erased_edge) const;
+        std::vector<Solution> solve_fast_backward(const std::vector<char> &erased_edge) const;
         std::vector<Solution> solve_elem_on_generic_graph(bool smart) const;
         std::vector<Solution> solve_on_generic_graph(bool smart) const;
     };
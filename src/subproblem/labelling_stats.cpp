@@ -0,0 +1,49 @@
+//  Created by Alberto Santini on 18/09/13.
+//  Copyright (c) 2013 Alberto Santini. All rights reserved.
+//
+
+#include <algorithm>
+
+#include "labelling_stats.h"
+
+namespace mvrp {
+    void LabellingStats::add(const LabellingStats& other) {
+        runs += other.runs;
+        labels_extended += other.labels_extended;
+        labels_infeasible += other.labels_infeasible;
+        labels_created += other.labels_created;
+        dominated_unprocessed += other.dominated_unprocessed;
+        dominated_undominated += other.dominated_undominated;
+        beam_discarded += other.beam_discarded;
+        labels_kept += other.labels_kept;
+        vertices_processed += other.vertices_processed;
+        max_labels_per_vertex = std::max(max_labels_per_vertex, other.max_labels_per_vertex);
+        peak_label_bytes = std::max(peak_label_bytes, other.peak_label_bytes);
+        extension_time += other.extension_time;
+        dominance_time += other.dominance_time;
+        end_vertex_time += other.end_vertex_time;
+        path_time += other.path_time;
+        total_time += other.total_time;
+    }
+
+    std::string LabellingStats::csv_header() {
+        return  "runs,labels_extended,labels_infeasible,labels_created,dominated_unprocessed,dominated_undominated,"
+                "beam_discarded,max_labels_per_vertex,mean_labels_per_vertex,peak_label_bytes,"
+                "extension_time,dominance_time,end_vertex_time,path_time,total_time";
+    }
+
+    void LabellingStats::print_csv(std::ostream& out) const {
+        out << runs << "," << labels_extended << "," << labels_infeasible << "," << labels_created << ","
+            << dominated_unprocessed << "," << dominated_undominated << "," << beam_discarded << ","
+            << max_labels_per_vertex << "," << mean_labels_per_vertex() << "," << peak_label_bytes << ","
+            << extension_time << "," << dominance_time << "," << end_vertex_time << "," << path_time << "," << total_time;
+    }
+
+    std::ostream& operator<<(std::ostream& out, const LabellingStats& s) {
+        out << s.runs << " runs, " << s.labels_extended << " extensions (" << s.labels_infeasible << " infeasible), "
+            << s.labels_created << " labels created, " << s.dominated_unprocessed << " + " << s.dominated_undominated << " dominated, "
+            << s.beam_discarded << " beam-discarded, " << s.max_labels_per_vertex << " max / " << s.mean_labels_per_vertex()
+            << " mean labels per vertex, " << s.peak_label_bytes / 1024u << " KiB peak, " << s.total_time << "s";
+        return out;
+    }
+}
@@ -0,0 +1,82 @@
+//  Created by Alberto Santini on 18/09/13.
+//  Copyright (c) 2013 Alberto Santini. All rights reserved.
+//
+
+#ifndef LABELLING_STATS_H
+#define LABELLING_STATS_H
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+/* Set to false to compile the labelling algorithms without collecting statistics */
+#ifndef LABELLING_STATS
+#define LABELLING_STATS true
+#endif
+
+namespace mvrp {
+    /**
+     * Counters collected by the labelling and pulse algorithms. The counters of several runs
+     * (e.g. of all the pricing calls at a B&B node) can be added together.
+     */
+    struct LabellingStats {
+        /* Number of runs of the algorithms */
+        unsigned long runs = 0u;
+
+        /* Extensions tried, and how many of them were infeasible */
+        unsigned long labels_extended = 0u;
+        unsigned long labels_infeasible = 0u;
+
+        /* Labels created by a feasible extension */
+        unsigned long labels_created = 0u;
+
+        /* New labels dominated by a label already at the same vertex */
+        unsigned long dominated_unprocessed = 0u;
+
+        /* Labels already at a vertex, dominated by a new label */
+        unsigned long dominated_undominated = 0u;
+
+        /* Undominated labels discarded because of the limit on labels per vertex */
+        unsigned long beam_discarded = 0u;
+
+        /* Labels kept at the vertices, and number of vertices processed: their ratio is the mean number of labels per vertex */
+        unsigned long labels_kept = 0u;
+        unsigned long vertices_processed = 0u;
+        std::size_t max_labels_per_vertex = 0u;
+
+        /* Peak memory used by the labels, in bytes */
+        std::size_t peak_label_bytes = 0u;
+
+        /* Time spent extending labels and removing dominated ones, summed over all threads */
+        double extension_time = 0.0;
+        double dominance_time = 0.0;
+
+        /* Wall time spent extending labels to the end vertex and building the paths */
+        double end_vertex_time = 0.0;
+        double path_time = 0.0;
+
+        /* Total wall time */
+        double total_time = 0.0;
+
+        double mean_labels_per_vertex() const { return vertices_processed > 0u ? (double) labels_kept / vertices_processed : 0.0; }
+
+        /**
+         * Adds the counters of another run. Maxima and peaks are combined by taking the largest one.
+         */
+        void add(const LabellingStats& other);
+
+        /**
+         * Names of the fields, comma-separated, in the same order as print_csv.
+         */
+        static std::string csv_header();
+
+        /**
+         * Prints the fields, comma-separated.
+         */
+        void print_csv(std::ostream& out) const;
+    };
+
+    std::ostream& operator<<(std::ostream& out, const LabellingStats& s);
+}
+
+#endif
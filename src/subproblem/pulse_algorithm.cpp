@@ -0,0 +1,201 @@
+//  Created by Alberto Santini on 18/09/13.
+//  Copyright (c) 2013 Alberto Santini. All rights reserved.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include "pulse_algorithm.h"
+
+namespace mvrp {
+    std::vector<double> PulseAlgorithm::backward_bounds(Vertex end_v, const LabelExtender& extension) const {
+        const auto& graph = g->graph;
+        auto lb = std::vector<double>(num_vertices(graph), std::numeric_limits<double>::max());
+
+        lb[graph[end_v]->boost_vertex_id] = 0.0;
+
+        // Shortest path to the end vertex, ignoring capacity and elementarity
+        for(auto level = g->topological_levels.rbegin(); level != g->topological_levels.rend(); ++level) {
+            for(const auto& v : *level) {
+                if(v == end_v) { continue; }
+
+                auto& v_lb = lb[graph[v]->boost_vertex_id];
+
+                for(auto oe = out_edges(v, graph); oe.first != oe.second; ++oe.first) {
+                    if(extension.is_erased(*oe.first)) { continue; }
+
+                    auto w_lb = lb[graph[target(*oe.first, graph)]->boost_vertex_id];
+
+                    if(w_lb == std::numeric_limits<double>::max()) { continue; }
+
+                    v_lb = std::min(v_lb, extension.reduced_cost(*oe.first) + w_lb);
+                }
+            }
+        }
+
+        return lb;
+    }
+
+    double PulseAlgorithm::bound(const Search& search) const {
+        // We are only interested in negative reduced cost paths, better than the worst one we already kept
+        if(search.options.max_columns == 0u || search.best.size() < search.options.max_columns) { return 0.0; }
+        return std::min(0.0, search.best.back().first);
+    }
+
+    bool PulseAlgorithm::rolls_back(const Search& search, const Edge& e) const {
+        if(search.path.empty()) { return false; }
+
+        const auto& graph = g->graph;
+        const auto& last = search.path.back();
+        auto u = source(last, graph);
+        auto w = target(e, graph);
+
+        bool found;
+        Edge direct;
+        std::tie(direct, found) = boost::edge(u, w, graph);
+
+        if(!found) { return false; }
+
+        const auto& extension = search.extension;
+        if(extension.is_erased(direct)) { return false; }
+
+        // Going directly from u to w uses less capacity and keeps more ports visitable: if it is also
+        // cheaper, the partial path through the current vertex cannot be part of a better column.
+        return extension.reduced_cost(direct) < extension.reduced_cost(last) + extension.reduced_cost(e) - Label::EPS;
+    }
+
+    void PulseAlgorithm::add_path(Search& search, double cost) const {
+        if(cost >= bound(search)) { return; }
+
+        // The path is stored from the last edge to the first one, as in the labelling algorithm
+        Path p(search.path.rbegin(), search.path.rend());
+        auto pos = std::upper_bound(search.best.begin(), search.best.end(), cost,
+                                    [] (double c, const PathWithCost& pc) { return c < pc.first; });
+
+        search.best.insert(pos, std::make_pair(cost, p));
+        if(search.options.max_columns > 0u && search.best.size() > search.options.max_columns) { search.best.pop_back(); }
+
+        if(search.options.max_columns > 0u) {
+            auto negative_paths = std::count_if(search.best.begin(), search.best.end(),
+                [&search] (const PathWithCost& pc) { return pc.first < search.options.rc_threshold; }
+            );
+
+            if((unsigned int) negative_paths >= search.options.max_columns) { search.stop = true; }
+        }
+    }
+
+    template<typename Lbl>
+    void PulseAlgorithm::pulse(Search& search, Vertex cur_vertex, const Lbl& label) const {
+        if(++search.n_pulses % LabellingOptions::cancellation_check_interval == 0u && search.options.cancellation.is_cancelled()) {
+            search.stop = true;
+            return;
+        }
+
+        if(cur_vertex == search.end_v) {
+            add_path(search, label.cost);
+            return;
+        }
+
+        const auto& graph = g->graph;
+        std::vector<std::pair<double, Edge>> candidates;
+
+        for(auto oe = out_edges(cur_vertex, graph); oe.first != oe.second; ++oe.first) {
+            auto w_lb = search.lb[graph[target(*oe.first, graph)]->boost_vertex_id];
+
+            if(w_lb == std::numeric_limits<double>::max()) { continue; }
+
+            candidates.push_back(std::make_pair(label.cost + search.extension.reduced_cost(*oe.first) + w_lb, *oe.first));
+        }
+
+        // Explore the most promising edges first, to find good columns early and prune more
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [] (const auto& c1, const auto& c2) { return c1.first < c2.first; });
+
+        Lbl new_label;
+
+        for(const auto& candidate : candidates) {
+            if(search.stop) { return; }
+
+            // Since candidates are sorted by bound, none of the remaining ones can be better
+            if(candidate.first >= bound(search)) { return; }
+
+            const Edge& e = candidate.second;
+
+            if(rolls_back(search, e)) { continue; }
+
+            if(LABELLING_STATS) { ++search.stats.labels_extended; }
+
+            if(!search.extension(label, e, new_label)) {
+                if(LABELLING_STATS) { ++search.stats.labels_infeasible; }
+                continue;
+            }
+
+            if(LABELLING_STATS) { ++search.stats.labels_created; }
+
+            search.path.push_back(e);
+            pulse(search, target(e, graph), new_label);
+            search.path.pop_back();
+        }
+    }
+
+    template<typename Lbl>
+    std::vector<Solution> PulseAlgorithm::solve(Vertex start_v, Vertex end_v, Lbl start_label, LabelExtender extension, LabellingOptions options) const {
+        auto start_time = std::chrono::steady_clock::now();
+        const auto& graph = g->graph;
+        auto lb = backward_bounds(end_v, extension);
+
+        std::vector<Edge> first_edges;
+        for(auto oe = out_edges(start_v, graph); oe.first != oe.second; ++oe.first) { first_edges.push_back(*oe.first); }
+
+        // Each subtree rooted at an out-edge of the start vertex is explored independently
+        std::vector<std::vector<PathWithCost>> subtree_best(first_edges.size());
+        std::vector<LabellingStats> subtree_stats(first_edges.size());
+
+        auto explore_subtree = [&] (std::size_t i) {
+            Search search(extension, lb, end_v, options);
+
+            if(options.cancellation.is_cancelled()) { return; }
+
+            Lbl new_label;
+
+            if(!extension(start_label, first_edges[i], new_label)) { return; }
+
+            search.path.push_back(first_edges[i]);
+            pulse(search, target(first_edges[i], graph), new_label);
+            subtree_best[i] = search.best;
+            subtree_stats[i] = search.stats;
+        };
+
+        if(pool) {
+            pool->parallel_for(first_edges.size(), explore_subtree);
+        } else {
+            for(auto i = 0u; i < first_edges.size(); i++) { explore_subtree(i); }
+        }
+
+        std::vector<PathWithCost> best;
+        for(const auto& sb : subtree_best) { best.insert(best.end(), sb.begin(), sb.end()); }
+
+        std::stable_sort(best.begin(), best.end(), [] (const auto& pc1, const auto& pc2) { return pc1.first < pc2.first; });
+
+        std::vector<Solution> sols;
+        if(options.max_columns > 0u && best.size() > options.max_columns) { best.resize(options.max_columns); }
+
+        for(auto i = 0u; i < best.size(); i++) {
+            sols.emplace_back(best[i].second, best[i].first, g);
+        }
+
+        if(LABELLING_STATS && options.stats) {
+            LabellingStats stats;
+            stats.runs = 1u;
+            for(const auto& ss : subtree_stats) { stats.add(ss); }
+            stats.total_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+            options.stats->add(stats);
+        }
+
+        return sols;
+    }
+
+    template std::vector<Solution> PulseAlgorithm::solve<Label>(Vertex start_v, Vertex end_v, Label start_label, LabelExtender extension, LabellingOptions options) const;
+    template std::vector<Solution> PulseAlgorithm::solve<ElementaryLabel>(Vertex start_v, Vertex end_v, ElementaryLabel start_label, LabelExtender extension, LabellingOptions options) const;
+}
@@ -0,0 +1,70 @@
+//  Created by Alberto Santini on 18/09/13.
+//  Copyright (c) 2013 Alberto Santini. All rights reserved.
+//
+
+#ifndef PULSE_ALGORITHM_H
+#define PULSE_ALGORITHM_H
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "../base/graph.h"
+#include "../base/task_pool.h"
+#include "../column/solution.h"
+#include "_labelling.h"
+
+namespace mvrp {
+    /**
+     * Depth-first (pulse) algorithm for the pricing problem: with Label it solves the SPPRC, with
+     * ElementaryLabel the ESPPRC. Partial paths are pruned when: they cannot be extended (capacity,
+     * elementarity, erased edges); the lower bound on the reduced cost of their completion, computed
+     * backwards on the graph, shows that they cannot beat the columns already found; or skipping their
+     * last-but-one vertex gives a cheaper partial path (rollback). Memory only grows with the length of
+     * the path being explored. If a task pool is given, the subtrees rooted at the out-edges of the start
+     * vertex are explored in parallel.
+     */
+    class PulseAlgorithm {
+        using PathWithCost = std::pair<double, Path>;
+
+        std::shared_ptr<const Graph> g;
+        TaskPool* pool;
+
+        struct Search {
+            const LabelExtender& extension;
+            const std::vector<double>& lb;
+            Vertex end_v;
+            LabellingOptions options;
+            std::vector<PathWithCost> best;
+            Path path;
+            unsigned int n_pulses;
+            bool stop;
+            LabellingStats stats;
+
+            Search(const LabelExtender& extension, const std::vector<double>& lb, Vertex end_v, LabellingOptions options) :
+                   extension{extension}, lb{lb}, end_v{end_v}, options{options}, n_pulses{0u}, stop{false} {}
+        };
+
+        std::vector<double> backward_bounds(Vertex end_v, const LabelExtender& extension) const;
+        double bound(const Search& search) const;
+        bool rolls_back(const Search& search, const Edge& e) const;
+        void add_path(Search& search, double cost) const;
+        template<typename Lbl> void pulse(Search& search, Vertex cur_vertex, const Lbl& label) const;
+
+    public:
+        PulseAlgorithm(std::shared_ptr<const Graph> g, TaskPool* pool = nullptr) : g{g}, pool{pool} {}
+
+        /**
+         * Finds the paths from start_v to end_v with negative reduced cost. As in the labelling algorithm,
+         * if options.max_columns is positive only the best options.max_columns paths are kept (the worst of
+         * them is used to prune partial paths), and the search stops as soon as it has that many paths with
+         * reduced cost below options.rc_threshold. If options.cancellation is cancelled, the search stops
+         * and returns the paths found so far.
+         */
+        template<typename Lbl>
+        std::vector<Solution> solve(Vertex start_v, Vertex end_v, Lbl start_label, LabelExtender extension, LabellingOptions options = LabellingOptions()) const;
+    };
+}
+
+#endif
@@ -2,438 +2,454 @@
 //  Copyright (c) 2013 Alberto Santini. All rights reserved.
 //
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <iterator>
 #include <limits>
+#include <map>
 #include <mutex>
+#include <numeric>
 #include <string>
-#include <thread>
 
 #include "sp_solver.h"
 
 namespace mvrp {
-    bool SPSolver::solution_in_pool(const Solution &s, const ColumnPool &pool) const {
-        return (std::find_if(pool.begin(), pool.end(), [&s](const Column &c) { return (s == c.sol); }) != pool.end());
+    const std::vector<PricingStage> SPSolver::stages = {
+        PricingStage::LOCAL_SEARCH, PricingStage::FAST_H, PricingStage::ESPPRC_CP, PricingStage::ESPPRC_P, PricingStage::SPPRC_SPARSE,
+        PricingStage::SPPRC_SMART, PricingStage::SPPRC_RED, PricingStage::SPPRC_BEAM, PricingStage::SPPRC
+    };
+
+    ColumnOrigin SPSolver::origin_of(PricingStage stage) {
+        switch(stage) {
+            case PricingStage::LOCAL_SEARCH: return ColumnOrigin::LOCAL_SEARCH;
+            case PricingStage::FAST_H: return ColumnOrigin::FAST_H;
+            case PricingStage::ESPPRC_CP: return ColumnOrigin::ESPPRC;
+            case PricingStage::ESPPRC_P: return ColumnOrigin::ESPPRC;
+            case PricingStage::SPPRC_SPARSE: return ColumnOrigin::SPPRC_SPARSE;
+            case PricingStage::SPPRC_SMART: return ColumnOrigin::SPPRC_SMART;
+            case PricingStage::SPPRC_RED: return ColumnOrigin::SPPRC_RED;
+            case PricingStage::SPPRC_BEAM: return ColumnOrigin::SPPRC_BEAM;
+            case PricingStage::SPPRC: return ColumnOrigin::SPPRC;
+        }
+        return ColumnOrigin::NONE;
     }
 
-    void SPSolver::print_report(int sols_found, int discarded_prc, int discarded_infeasible, int discarded_generated,
-                                int discarded_in_pool, std::ostream &out) const {
-        out << "\t\t\tWe found " << sols_found << " new columns." << std::endl;
-        out << "\t\t\t\t" << discarded_prc << " columns were discarded because they have positive reduced cost." << std::endl;
-        out << "\t\t\t\t" << discarded_infeasible << " columns were discarded because they're infeasible wrt capacity constraints." << std::endl;
-        out << "\t\t\t\t" << discarded_generated << " columns were discarded because they had already been generated in this iteration." << std::endl;
-        out << "\t\t\t\t" << discarded_in_pool << " columns were discarded because they were already in the columns pool." << std::endl;
+    void SPSolver::print_report(const std::vector<Solution> &sols_found, const Discarded &discarded, std::ostream &out) const {
+        out << "\t\t\tWe found " << sols_found.size() << " new columns." << std::endl;
+        out << "\t\t\t\t" << discarded.prc << " columns were discarded because they have positive reduced cost." << std::endl;
+        out << "\t\t\t\t" << discarded.infeasible << " columns were discarded because they're infeasible wrt capacity constraints." << std::endl;
+        out << "\t\t\t\t" << discarded.generated << " columns were discarded because they had already been generated in this iteration." << std::endl;
+        out << "\t\t\t\t" << discarded.in_pool << " columns were discarded because they were already in the columns pool." << std::endl;
     }
 
-    std::pair<int, ColumnOrigin>
-    SPSolver::solve(ColumnPool &node_pool, std::shared_ptr<ColumnPool> global_pool, bool try_elementary, double &max_time_spent_by_exact_solver) const {
-        std::vector<Solution> valid_sols;
-
-        auto discarded_prc = 0;
-        auto discarded_infeasible = 0;
-        auto discarded_generated = 0;
-        auto discarded_in_pool = 0;
-
-        /********************** FAST HEURISTICS **********************/
+    std::vector<Column> SPSolver::price_global_pool(const ColumnPool &global_pool, const SolutionIndex &node_index) const {
+        auto np = prob->data.num_ports;
+        auto nv = prob->data.num_vessel_classes;
 
-        if(PEDANTIC) { std::cerr << "\t\tFast heuristic" << std::endl; }
+        // Duals in the same order as the column coefficients
+        auto port_duals = std::vector<double>(2 * (np - 1), 0.0);
+        auto vc_duals = std::vector<double>(nv, 0.0);
+        auto erased_edges = std::map<std::shared_ptr<VesselClass>, std::vector<char>>();
 
-        for(auto vcit = prob->data.vessel_classes.begin(); vcit != prob->data.vessel_classes.end(); ++vcit) {
-            auto g = prob->graphs.at(*vcit);
-            const auto &erased = local_erased_edges.at(*vcit);
+        for(auto i = 0; i < nv; i++) {
+            const auto &vc = prob->data.vessel_classes[i];
+            auto g = prob->graphs.at(vc);
 
-            HeuristicsSolver hsolv(prob, g, erased);
+            vc_duals[i] = g->graph[boost::graph_bundle].vc_dual;
 
-            auto total = hsolv.solve_fast();
-
-            for(const auto &s : total) {
-                if(s.reduced_cost > 0.0) {
-                    discarded_prc++;
-                } else if(!s.satisfies_capacity_constraints()) {
-                    discarded_infeasible++;
-                } else if(find(valid_sols.begin(), valid_sols.end(), s) != valid_sols.end()) {
-                    discarded_generated++;
-                } else if(solution_in_pool(s, node_pool)) {
-                    discarded_in_pool++;
-                } else {
-                    valid_sols.push_back(s);
-                }
+            auto &erased = erased_edges[vc];
+            erased = std::vector<char>(num_edges(g->graph), 0);
+            for(const auto &ve : local_erased_edges.at(vc)) {
+                for(const auto &e : ve.second) { erased[g->graph[e]->boost_edge_id] = 1; }
             }
         }
 
-        if(PEDANTIC) {
-            print_report(valid_sols.size(), discarded_prc, discarded_infeasible, discarded_generated, discarded_in_pool);
+        // All graphs share the same port duals
+        const auto &duals = prob->graphs.begin()->second->graph[boost::graph_bundle].port_duals;
+        for(auto i = 1; i < np; i++) {
+            auto it = duals.find(prob->data.ports[i]);
+            if(it == duals.end()) { continue; }
+            port_duals[i - 1] = it->second.first;
+            port_duals[np - 1 + i - 1] = it->second.second;
         }
 
-        if(valid_sols.size() > 0) {
-            for(const auto &s : valid_sols) {
-                Column col(prob, s, ColumnOrigin::FAST_H);
-                node_pool.push_back(col);
-                global_pool->push_back(col);
-            }
-            return std::make_pair(valid_sols.size(), ColumnOrigin::FAST_H);
-        } else {
-            discarded_prc = 0;
-            discarded_infeasible = 0;
-            discarded_generated = 0;
-            discarded_in_pool = 0;
+        auto cols = std::vector<Column>();
+
+        for(const auto &c : global_pool) {
+            if(c.dummy) { continue; }
+
+            auto rc = c.obj_coeff -
+                      std::inner_product(c.port_coeff.begin(), c.port_coeff.end(), port_duals.begin(), 0.0) -
+                      std::inner_product(c.vc_coeff.begin(), c.vc_coeff.end(), vc_duals.begin(), 0.0);
+
+            if(rc >= pool_rc_threshold) { continue; }
+
+            // A column which does not use erased edges complies with all the branching rules at this node
+            const auto &erased = erased_edges.at(c.sol.vessel_class);
+            const auto &graph = c.sol.g->graph;
+            if(std::any_of(c.sol.path.begin(), c.sol.path.end(), [&] (const Edge &e) { return erased[graph[e]->boost_edge_id]; })) { continue; }
+
+            if(node_index.contains(c.sol)) { continue; }
+
+            cols.push_back(c);
+            cols.back().sol.reduced_cost = rc;
         }
 
-        for(const auto &vc : prob->data.vessel_classes) {
-            prob->graphs.at(vc)->sort_arcs();
+        return cols;
+    }
+
+    bool SPSolver::is_enabled(PricingStage stage, const std::vector<Solution> &base_routes, bool try_elementary) const {
+        switch(stage) {
+            case PricingStage::LOCAL_SEARCH: return prob->params.local_search_pricing && !base_routes.empty();
+            case PricingStage::FAST_H: return true;
+            case PricingStage::ESPPRC_CP: return prob->params.enable_cost_prize_acceleration && try_elementary;
+            case PricingStage::ESPPRC_P: return prob->params.enable_prize_acceleration && try_elementary;
+            case PricingStage::SPPRC_SPARSE: return prob->params.sparse_pricing_out_arcs > 0u;
+            case PricingStage::SPPRC_SMART: return prob->params.enable_prize_acceleration;
+            case PricingStage::SPPRC_RED: return prob->params.enable_cost_prize_acceleration;
+            case PricingStage::SPPRC_BEAM: return prob->params.beam_labelling_width > 0u;
+            case PricingStage::SPPRC: return true;
         }
+        return false;
+    }
 
-        /********************** ELEMENTARY LABELLING WITH C+P **********************/
+    std::vector<PricingStage> SPSolver::scheduled_stages(const std::vector<Solution> &base_routes, bool try_elementary) const {
+        auto enabled = std::vector<PricingStage>();
+        std::copy_if(stages.begin(), stages.end(), std::back_inserter(enabled), [&] (PricingStage stage) { return is_enabled(stage, base_routes, try_elementary); });
 
-        if(prob->params.enable_cost_prize_acceleration && try_elementary) {
-            if(PEDANTIC) { std::cerr << "\t\tElementary labelling C+P" << std::endl; }
-            auto elem_sols = std::make_shared<std::vector<Solution>>();
+        if(prob->stage_scheduler) { return prob->stage_scheduler->schedule(enabled); }
 
-            if(prob->params.parallel_labelling) {
-                std::mutex mtx;
-                std::vector<std::thread> threads;
+        return enabled;
+    }
 
-                for(auto vcit = prob->data.vessel_classes.begin();
-                    vcit != prob->data.vessel_classes.end(); ++vcit) {
-                    std::shared_ptr<const Graph> g = prob->graphs.at(*vcit);
-                    const auto &erased = local_erased_edges.at(*vcit);
+    std::vector<Solution> SPSolver::run_stage(PricingStage stage, const std::vector<std::shared_ptr<VesselClass>> &vcs, const std::vector<Solution> &base_routes, bool prove_optimality, double &max_time_spent_by_exact_solver, const CancellationToken &cancellation, LabellingStats &stats, VesselClassTimes &vc_times) const {
+        using namespace std::chrono;
 
-                    threads.push_back(std::thread(
-                        [this, g, &erased, &elem_sols, &mtx]() noexcept {
-                            HeuristicsSolver hsolv(prob, g, erased);
-                            auto sols = hsolv.solve_elem_on_reduced_graph();
+        auto stage_sols = std::vector<Solution>();
+        std::mutex mtx;
 
-                            std::lock_guard<std::mutex> guard(mtx);
-                            elem_sols->insert(elem_sols->end(), sols.begin(), sols.end());
-                        }
-                    ));
-                }
+        for_each_vessel_class(vcs, [&] (const std::shared_ptr<VesselClass> &vc) {
+            auto vc_start = high_resolution_clock::now();
+            std::shared_ptr<const Graph> g = prob->graphs.at(vc);
+            const auto &erased = local_erased_edges.at(vc);
+            LabellingStats vc_stats;
+            std::vector<Solution> sols;
 
-                for(auto &t : threads) {
-                    t.join();
-                }
+            if(stage == PricingStage::SPPRC) {
+                ExactSolver esolv(prob, g, erased, cancellation, &vc_stats);
+                // Writing a double should be atomic on all x86_64 (-malign-double)
+                sols = esolv.solve(max_time_spent_by_exact_solver, prove_optimality);
             } else {
-                for(auto vcit = prob->data.vessel_classes.begin();
-                    vcit != prob->data.vessel_classes.end(); ++vcit) {
-                    std::shared_ptr<const Graph> g = prob->graphs.at(*vcit);
-                    const auto &erased = local_erased_edges.at(*vcit);
-                    HeuristicsSolver hsolv(prob, g, erased);
-                    auto sols = hsolv.solve_elem_on_reduced_graph();
-                    elem_sols->insert(elem_sols->end(), sols.begin(), sols.end());
+                auto critical = (stage == PricingStage::ESPPRC_CP || stage == PricingStage::ESPPRC_P) ? &critical_ports.at(vc) : nullptr;
+                HeuristicsSolver hsolv(prob, g, erased, critical, cancellation, &vc_stats, node_number);
+
+                switch(stage) {
+                    case PricingStage::LOCAL_SEARCH: sols = hsolv.solve_local_search(base_routes); break;
+                    case PricingStage::FAST_H: sols = hsolv.solve_fast(); break;
+                    case PricingStage::ESPPRC_CP: sols = hsolv.solve_elem_on_reduced_graph(); break;
+                    case PricingStage::ESPPRC_P: sols = hsolv.solve_elem_on_smart_graph(); break;
+                    case PricingStage::SPPRC_SPARSE: sols = hsolv.solve_on_sparse_graph(); break;
+                    case PricingStage::SPPRC_SMART: sols = hsolv.solve_on_smart_graph(); break;
+                    case PricingStage::SPPRC_RED: sols = hsolv.solve_on_reduced_graph(); break;
+                    case PricingStage::SPPRC_BEAM: sols = hsolv.solve_beam(); break;
+                    case PricingStage::SPPRC: break;
                 }
             }
 
-            for(const auto &s : *elem_sols) {
-                if(s.reduced_cost > 0.0) {
-                    discarded_prc++;
-                } else if(find(valid_sols.begin(), valid_sols.end(), s) != valid_sols.end()) {
-                    discarded_generated++;
-                } else if(solution_in_pool(s, node_pool)) {
-                    discarded_in_pool++;
-                } else {
-                    valid_sols.push_back(s);
-                }
+            auto vc_time = duration_cast<duration<double>>(high_resolution_clock::now() - vc_start).count();
 
-                if(PEDANTIC) { assert(s.satisfies_capacity_constraints()); }
-            }
+            // The labelling only stops early if cancelled, or if it finds enough columns below the threshold
+            auto complete = (stage == PricingStage::SPPRC) && !cancellation.is_cancelled() && (prove_optimality ||
+                std::count_if(sols.begin(), sols.end(), [&] (const Solution &s) { return s.reduced_cost < prob->params.exact_pricing_rc_threshold; }) < prob->params.exact_pricing_max_columns);
 
-            if(PEDANTIC) {
-                print_report(valid_sols.size(), discarded_prc, discarded_infeasible, discarded_generated, discarded_in_pool);
+            std::lock_guard<std::mutex> guard(mtx);
+            if(min_reduced_costs && complete) {
+                auto min_rc = 0.0;
+                for(const auto &s : sols) { min_rc = std::min(min_rc, s.reduced_cost); }
+                (*min_reduced_costs)[vc] = min_rc;
             }
+            stage_sols.insert(stage_sols.end(), sols.begin(), sols.end());
+            stats.add(vc_stats);
+            vc_times[vc] += vc_time;
+        });
 
-            if(valid_sols.size() > 0) {
-                for(const auto &s : valid_sols) {
-                    Column col(prob, s, ColumnOrigin::ESPPRC);
-                    node_pool.push_back(col);
-                    global_pool->push_back(col);
-                }
-                return std::make_pair(valid_sols.size(), ColumnOrigin::ESPPRC);
+        return stage_sols;
+    }
+
+    std::vector<Solution> SPSolver::new_solutions(PricingStage stage, const std::vector<Solution> &sols, const SolutionIndex &node_index, ConcurrentSolutionIndex &generated, Discarded &discarded) const {
+        auto valid_sols = std::vector<Solution>();
+
+        // The greedy heuristics do not check the capacity of the vessel
+        auto check_capacity = (stage == PricingStage::FAST_H);
+
+        for(const auto &s : sols) {
+            if(s.reduced_cost > 0.0) {
+                discarded.prc++;
+            } else if(check_capacity && !s.satisfies_capacity_constraints()) {
+                discarded.infeasible++;
+            } else if(generated.contains(s)) {
+                discarded.generated++;
+                if(s.reduced_cost < 0.0) { discarded.negative++; }
+            } else if(node_index.contains(s)) {
+                discarded.in_pool++;
+                if(s.reduced_cost < 0.0) { discarded.negative++; }
             } else {
-                discarded_prc = 0;
-                discarded_infeasible = 0;
-                discarded_generated = 0;
-                discarded_in_pool = 0;
+                generated.insert(s);
+                valid_sols.push_back(s);
             }
+
+            if(PEDANTIC && !check_capacity) { assert(s.satisfies_capacity_constraints()); }
         }
 
-        /********************** ELEMENTARY LABELLING WITH P **********************/
+        return valid_sols;
+    }
 
-        if(prob->params.enable_prize_acceleration && try_elementary) {
-            if(PEDANTIC) { std::cerr << "\t\tElementary labelling P" << std::endl; }
-            auto elem_sols = std::make_shared<std::vector<Solution>>();
+    std::vector<Column> SPSolver::select_columns(std::vector<Column> cols) const {
+        auto max_columns = prob->params.max_columns_per_iteration;
 
-            if(prob->params.parallel_labelling) {
-                std::mutex mtx;
-                std::vector<std::thread> threads;
+        if(max_columns == 0u || cols.size() <= max_columns) { return cols; }
 
-                for(auto vcit = prob->data.vessel_classes.begin();
-                    vcit != prob->data.vessel_classes.end(); ++vcit) {
-                    std::shared_ptr<const Graph> g = prob->graphs.at(*vcit);
-                    const auto &erased = local_erased_edges.at(*vcit);
+        std::stable_sort(cols.begin(), cols.end(), [] (const Column &c1, const Column &c2) { return c1.sol.reduced_cost < c2.sol.reduced_cost; });
 
-                    threads.push_back(std::thread(
-                        [this, g, &erased, &elem_sols, &mtx]() noexcept {
-                            HeuristicsSolver hsolv(prob, g, erased);
-                            auto sols = hsolv.solve_elem_on_smart_graph();
+        auto selected = std::vector<Column>();
+        auto taken = std::vector<bool>(cols.size(), false);
+        auto covered = std::vector<bool>(cols.front().port_coeff.size(), false);
 
-                            std::lock_guard<std::mutex> guard(mtx);
-                            elem_sols->insert(elem_sols->end(), sols.begin(), sols.end());
-                        }
-                    ));
-                }
+        for(auto i = 0u; i < cols.size() && selected.size() < max_columns; i++) {
+            auto new_port = false;
 
-                for(auto &t : threads) {
-                    t.join();
-                }
-            } else {
-                for(auto vcit = prob->data.vessel_classes.begin();
-                    vcit != prob->data.vessel_classes.end(); ++vcit) {
-                    std::shared_ptr<const Graph> g = prob->graphs.at(*vcit);
-                    const auto &erased = local_erased_edges.at(*vcit);
-                    HeuristicsSolver hsolv(prob, g, erased);
-                    auto sols = hsolv.solve_elem_on_smart_graph();
-                    elem_sols->insert(elem_sols->end(), sols.begin(), sols.end());
+            for(auto j = 0u; j < covered.size(); j++) {
+                if(cols[i].port_coeff[j] > 0.0 && !covered[j]) {
+                    covered[j] = true;
+                    new_port = true;
                 }
             }
 
-            for(const auto &s : *elem_sols) {
-                if(s.reduced_cost > 0.0) {
-                    discarded_prc++;
-                } else if(find(valid_sols.begin(), valid_sols.end(), s) != valid_sols.end()) {
-                    discarded_generated++;
-                } else if(solution_in_pool(s, node_pool)) {
-                    discarded_in_pool++;
-                } else {
-                    valid_sols.push_back(s);
-                }
-
-                if(PEDANTIC) { assert(s.satisfies_capacity_constraints()); }
+            if(new_port) {
+                selected.push_back(cols[i]);
+                taken[i] = true;
             }
+        }
 
-            if(PEDANTIC) {
-                print_report(valid_sols.size(), discarded_prc, discarded_infeasible, discarded_generated, discarded_in_pool);
-            }
+        for(auto i = 0u; i < cols.size() && selected.size() < max_columns; i++) {
+            if(!taken[i]) { selected.push_back(cols[i]); }
+        }
 
-            if(valid_sols.size() > 0) {
-                for(const auto &s : valid_sols) {
-                    Column col(prob, s, ColumnOrigin::ESPPRC);
-                    node_pool.push_back(col);
-                    global_pool->push_back(col);
-                }
-                return std::make_pair(valid_sols.size(), ColumnOrigin::ESPPRC);
-            } else {
-                discarded_prc = 0;
-                discarded_infeasible = 0;
-                discarded_generated = 0;
-                discarded_in_pool = 0;
-            }
+        if(PEDANTIC) { std::cerr << "\t\t\t" << cols.size() - selected.size() << " columns were left in the global pool." << std::endl; }
+
+        return selected;
+    }
+
+    int SPSolver::add_columns(const std::vector<Column> &cols, ColumnPool &node_pool, SolutionIndex &node_index, ColumnPool &global_pool, SolutionIndex &global_index) const {
+        for(const auto &col : cols) {
+            if(global_index.insert(col.sol)) { global_pool.push_back(col); }
         }
 
-        /********************** LABELLING WITH P **********************/
+        auto selected = select_columns(cols);
 
-        if(prob->params.enable_prize_acceleration) {
-            if(PEDANTIC) { std::cerr << "\t\tLabelling on the P-reduced graph" << std::endl; }
+        for(const auto &col : selected) {
+            node_pool.push_back(col);
+            node_index.insert(col.sol);
+        }
 
-            auto sred_sols = std::make_shared<std::vector<Solution>>();
+        return selected.size();
+    }
 
-            if(prob->params.parallel_labelling) {
-                std::mutex mtx;
-                std::vector<std::thread> threads;
+    std::pair<int, ColumnOrigin>
+    SPSolver::solve(ColumnPool &node_pool, SolutionIndex &node_index, std::shared_ptr<ColumnPool> global_pool, std::shared_ptr<SolutionIndex> global_index, const std::vector<Solution> &base_routes, bool try_elementary, double &max_time_spent_by_exact_solver, const CancellationToken &cancellation) const {
+        /********************** GLOBAL POOL **********************/
 
-                for(auto vcit = prob->data.vessel_classes.begin(); vcit != prob->data.vessel_classes.end(); ++vcit) {
-                    std::shared_ptr<const Graph> g = prob->graphs.at(*vcit);
-                    const auto &erased = local_erased_edges.at(*vcit);
+        if(prob->params.global_pool_pricing) {
+            if(PEDANTIC) { std::cerr << "\t\tReduced costs of the global pool columns" << std::endl; }
 
-                    threads.push_back(std::thread(
-                        [this, g, &erased, &sred_sols, &mtx]() noexcept {
-                            HeuristicsSolver hsolv(prob, g, erased);
-                            auto sols = hsolv.solve_on_smart_graph();
+            auto pool_cols = price_global_pool(*global_pool, node_index);
 
-                            std::lock_guard<std::mutex> guard(mtx);
-                            sred_sols->insert(sred_sols->end(), sols.begin(), sols.end());
-                        }
-                    ));
-                }
+            if(PEDANTIC) { std::cerr << "\t\t\tWe found " << pool_cols.size() << " columns in the global pool." << std::endl; }
 
-                for(auto &t : threads) {
-                    t.join();
-                }
-            } else {
-                for(auto vcit = prob->data.vessel_classes.begin(); vcit != prob->data.vessel_classes.end(); ++vcit) {
-                    std::shared_ptr<const Graph> g = prob->graphs.at(*vcit);
-                    const auto &erased = local_erased_edges.at(*vcit);
-                    HeuristicsSolver hsolv(prob, g, erased);
-                    auto sols = hsolv.solve_on_smart_graph();
-                    sred_sols->insert(sred_sols->end(), sols.begin(), sols.end());
-                }
+            if(pool_cols.size() > 0) {
+                return std::make_pair(add_columns(pool_cols, node_pool, node_index, *global_pool, *global_index), ColumnOrigin::POOL);
             }
+        }
 
-            for(const auto &s : *sred_sols) {
-                if(s.reduced_cost > 0.0) {
-                    discarded_prc++;
-                } else if(find(valid_sols.begin(), valid_sols.end(), s) != valid_sols.end()) {
-                    discarded_generated++;
-                } else if(solution_in_pool(s, node_pool)) {
-                    discarded_in_pool++;
-                } else {
-                    valid_sols.push_back(s);
-                }
+        // The duals changed since the last call: sort the adjacency lists used by the greedy heuristics.
+        // The arcs are only sorted by cost once, but it must happen before the stages run in parallel.
+        for(const auto &vc : prob->data.vessel_classes) {
+            prob->graphs.at(vc)->sort_adjacency();
+            prob->graphs.at(vc)->sort_arcs();
+        }
 
-                if(PEDANTIC) { assert(s.satisfies_capacity_constraints()); }
-            }
+        // Solutions found in this call; pricing threads can share it
+        ConcurrentSolutionIndex generated;
 
-            if(PEDANTIC) {
-                print_report(valid_sols.size(), discarded_prc, discarded_infeasible, discarded_generated, discarded_in_pool);
-            }
+        if(prob->params.pricing_racing) {
+            return solve_race(node_pool, node_index, *global_pool, *global_index, base_routes, try_elementary, max_time_spent_by_exact_solver, cancellation, generated);
+        } else {
+            return solve_cascade(node_pool, node_index, *global_pool, *global_index, base_routes, try_elementary, max_time_spent_by_exact_solver, cancellation, generated);
+        }
+    }
+
+    std::pair<int, ColumnOrigin>
+    SPSolver::solve_cascade(ColumnPool &node_pool, SolutionIndex &node_index, ColumnPool &global_pool, SolutionIndex &global_index, const std::vector<Solution> &base_routes, bool try_elementary, double &max_time_spent_by_exact_solver, const CancellationToken &cancellation, ConcurrentSolutionIndex &generated) const {
+        for(auto stage : scheduled_stages(base_routes, try_elementary)) {
+            if(cancellation.is_cancelled()) { break; }
+
+            if(PEDANTIC) { std::cerr << "\t\t" << stage << std::endl; }
+
+            auto valid_sols = prob->vessel_class_scheduler ?
+                price_partially(stage, node_index, base_routes, max_time_spent_by_exact_solver, cancellation, generated) :
+                price(stage, prob->data.vessel_classes, node_index, base_routes, max_time_spent_by_exact_solver, cancellation, generated);
 
             if(valid_sols.size() > 0) {
-                for(const auto &s : valid_sols) {
-                    Column col(prob, s, ColumnOrigin::SPPRC_SMART);
-                    node_pool.push_back(col);
-                    global_pool->push_back(col);
-                }
-                return std::make_pair(valid_sols.size(), ColumnOrigin::SPPRC_SMART);
+                auto cols = std::vector<Column>();
+                for(const auto &s : valid_sols) { cols.emplace_back(prob, s, origin_of(stage)); }
+
+                return std::make_pair(add_columns(cols, node_pool, node_index, global_pool, global_index), origin_of(stage));
             }
         }
 
-        /********************** LABELLING WITH C+P **********************/
+        return std::make_pair(0, ColumnOrigin::NONE);
+    }
 
-        if(prob->params.enable_cost_prize_acceleration) {
-            if(PEDANTIC) { std::cerr << "\t\tLabelling on the (C+P)-reduced graph" << std::endl; }
-            auto red_sols = std::make_shared<std::vector<Solution>>();
+    std::vector<Solution> SPSolver::price(PricingStage stage, const std::vector<std::shared_ptr<VesselClass>> &vcs, const SolutionIndex &node_index, const std::vector<Solution> &base_routes, double &max_time_spent_by_exact_solver, const CancellationToken &cancellation, ConcurrentSolutionIndex &generated) const {
+        using namespace std::chrono;
 
-            if(prob->params.parallel_labelling) {
-                std::mutex mtx;
-                std::vector<std::thread> threads;
+        auto prove_optimality = false;
 
-                for(auto vcit = prob->data.vessel_classes.begin();
-                    vcit != prob->data.vessel_classes.end(); ++vcit) {
-                    std::shared_ptr<const Graph> g = prob->graphs.at(*vcit);
-                    const auto &erased = local_erased_edges.at(*vcit);
+        while(true) {
+            LabellingStats stats;
+            VesselClassTimes vc_times;
+            auto stage_start = high_resolution_clock::now();
+            auto sols = run_stage(stage, vcs, base_routes, prove_optimality, max_time_spent_by_exact_solver, cancellation, stats, vc_times);
+            auto stage_time = duration_cast<duration<double>>(high_resolution_clock::now() - stage_start).count();
+            if(labelling_stats) { labelling_stats->add(stats); }
 
-                    threads.push_back(std::thread(
-                        [this, g, &erased, &red_sols, &mtx]() noexcept {
-                            HeuristicsSolver hsolv(prob, g, erased);
-                            auto sols = hsolv.solve_on_reduced_graph();
+            Discarded discarded;
+            auto valid_sols = new_solutions(stage, sols, node_index, generated, discarded);
 
-                            std::lock_guard<std::mutex> guard(mtx);
-                            red_sols->insert(red_sols->end(), sols.begin(), sols.end());
-                        }
-                    ));
-                }
+            if(PEDANTIC) { print_report(valid_sols, discarded); }
 
-                for(auto &t : threads) {
-                    t.join();
-                }
-            } else {
-                for(auto vcit = prob->data.vessel_classes.begin();
-                    vcit != prob->data.vessel_classes.end(); ++vcit) {
-                    std::shared_ptr<const Graph> g = prob->graphs.at(*vcit);
-                    const auto &erased = local_erased_edges.at(*vcit);
-                    HeuristicsSolver hsolv(prob, g, erased);
-                    auto sols = hsolv.solve_on_reduced_graph();
-                    red_sols->insert(red_sols->end(), sols.begin(), sols.end());
-                }
+            // A run stopped by the cancellation says nothing about the stage
+            if(prob->stage_scheduler && !cancellation.is_cancelled()) { prob->stage_scheduler->record(stage, stage_time, valid_sols, vc_times); }
+
+            // If the labelling might have stopped early, or dropped some labels, because of columns we had to discard,
+            // we run it again to completion, to make sure that no new negative column exists.
+            if(valid_sols.size() > 0 || stage != PricingStage::SPPRC || prove_optimality || discarded.negative == 0 || cancellation.is_cancelled()) {
+                return valid_sols;
             }
 
-            for(const auto &s : *red_sols) {
-                if(s.reduced_cost > 0.0) {
-                    discarded_prc++;
-                } else if(find(valid_sols.begin(), valid_sols.end(), s) != valid_sols.end()) {
-                    discarded_generated++;
-                } else if(solution_in_pool(s, node_pool)) {
-                    discarded_in_pool++;
-                } else {
-                    valid_sols.push_back(s);
-                }
+            if(PEDANTIC) { std::cerr << "\t\t" << stage << ", without column budget" << std::endl; }
 
-                if(PEDANTIC) { assert(s.satisfies_capacity_constraints()); }
-            }
+            prove_optimality = true;
+        }
+    }
 
-            if(PEDANTIC) {
-                print_report(valid_sols.size(), discarded_prc, discarded_infeasible, discarded_generated, discarded_in_pool);
-            }
+    std::vector<Solution> SPSolver::price_partially(PricingStage stage, const SolutionIndex &node_index, const std::vector<Solution> &base_routes, double &max_time_spent_by_exact_solver, const CancellationToken &cancellation, ConcurrentSolutionIndex &generated) const {
+        auto valid_sols = std::vector<Solution>();
 
-            if(valid_sols.size() > 0) {
-                for(const auto &s : valid_sols) {
-                    Column col(prob, s, ColumnOrigin::SPPRC_RED);
-                    node_pool.push_back(col);
-                    global_pool->push_back(col);
-                }
-                return std::make_pair(valid_sols.size(), ColumnOrigin::SPPRC_RED);
+        // If no class yields enough columns, all of them are priced: for the complete
+        // labelling, this is the full pass which proves that there are no new columns.
+        for(const auto &vc : prob->vessel_class_scheduler->order()) {
+            if(cancellation.is_cancelled()) { break; }
+
+            auto vc_sols = price(stage, {vc}, node_index, base_routes, max_time_spent_by_exact_solver, cancellation, generated);
+            auto enough = (vc_sols.size() >= std::max(prob->params.partial_pricing_min_columns, 1u));
+
+            prob->vessel_class_scheduler->record(vc, vc_sols.size(), enough);
+            valid_sols.insert(valid_sols.end(), vc_sols.begin(), vc_sols.end());
+
+            if(PEDANTIC) { std::cerr << "\t\t\t" << vc->name << ": " << vc_sols.size() << " new columns" << std::endl; }
+
+            if(enough) { break; }
+        }
+
+        return valid_sols;
+    }
+
+    std::pair<int, ColumnOrigin>
+    SPSolver::solve_race(ColumnPool &node_pool, SolutionIndex &node_index, ColumnPool &global_pool, SolutionIndex &global_index, const std::vector<Solution> &base_routes, bool try_elementary, double &max_time_spent_by_exact_solver, const CancellationToken &cancellation, ConcurrentSolutionIndex &generated) const {
+        // Each racer runs its stages one after the other. The two elementary labellings update the same critical
+        // ports, so they run in the same racer; as in the cascade, the second one only runs if the first fails.
+        // The scheduler can only skip stages here, as they all run at the same time.
+        using namespace std::chrono;
+
+        auto scheduled = scheduled_stages(base_routes, try_elementary);
+        auto racers = std::vector<std::vector<PricingStage>>();
+
+        for(auto stage : stages) {
+            if(std::find(scheduled.begin(), scheduled.end(), stage) == scheduled.end()) { continue; }
+
+            if(stage == PricingStage::ESPPRC_P && !racers.empty() && racers.back().front() == PricingStage::ESPPRC_CP) {
+                racers.back().push_back(stage);
             } else {
-                discarded_prc = 0;
-                discarded_infeasible = 0;
-                discarded_generated = 0;
-                discarded_in_pool = 0;
+                racers.push_back({stage});
             }
         }
 
-        /********************** LABELLING ON THE COMPLETE GRAPH **********************/
+        auto race_cancellation = cancellation.child();
+        auto target = std::max(prob->params.racing_target_columns, 1u);
+        auto found = std::vector<std::vector<Solution>>(racers.size());
+        auto found_origin = std::vector<ColumnOrigin>(racers.size(), ColumnOrigin::NONE);
+        auto n_found = 0u;
+        std::mutex mtx;
 
-        if(PEDANTIC) { std::cerr << "\t\tLabelling on the complete graph" << std::endl; }
+        auto run_racer = [&] (std::size_t i) {
+            for(auto stage : racers[i]) {
+                auto prove_optimality = false;
 
-        auto e_sols = std::make_shared<std::vector<Solution>>();
+                while(!race_cancellation.is_cancelled()) {
+                    LabellingStats stats;
+                    VesselClassTimes vc_times;
+                    auto stage_start = high_resolution_clock::now();
+                    auto sols = run_stage(stage, prob->data.vessel_classes, base_routes, prove_optimality, max_time_spent_by_exact_solver, race_cancellation, stats, vc_times);
+                    auto stage_time = duration_cast<duration<double>>(high_resolution_clock::now() - stage_start).count();
 
-        if(prob->params.parallel_labelling) {
-            std::mutex mtx;
-            std::vector<std::thread> threads;
+                    std::lock_guard<std::mutex> guard(mtx);
+                    if(labelling_stats) { labelling_stats->add(stats); }
 
-            for(auto vcit = prob->data.vessel_classes.begin(); vcit != prob->data.vessel_classes.end(); ++vcit) {
-                std::shared_ptr<const Graph> g = prob->graphs.at(*vcit);
-                const auto &erased = local_erased_edges.at(*vcit);
+                    Discarded discarded;
+                    auto valid_sols = new_solutions(stage, sols, node_index, generated, discarded);
 
-                threads.push_back(std::thread(
-                    [this, g, &erased, &e_sols, &mtx, &max_time_spent_by_exact_solver]() noexcept {
-                        ExactSolver esolv(g, erased);
-                        // Writing a double should be atomic on all x86_64 (-malign-double)
-                        auto sols = esolv.solve(max_time_spent_by_exact_solver);
+                    if(PEDANTIC) { std::cerr << "\t\t" << stage << ": " << valid_sols.size() << " new columns" << std::endl; }
 
-                        std::lock_guard<std::mutex> guard(mtx);
-                        e_sols->insert(e_sols->end(), sols.begin(), sols.end());
+                    // A racer stopped because the others won says nothing about its stage
+                    if(prob->stage_scheduler && (!valid_sols.empty() || !race_cancellation.is_cancelled())) {
+                        prob->stage_scheduler->record(stage, stage_time, valid_sols, vc_times);
                     }
-                ));
-            }
 
-            for(auto &t : threads) {
-                t.join();
-            }
-        } else {
-            for(auto vcit = prob->data.vessel_classes.begin(); vcit != prob->data.vessel_classes.end(); ++vcit) {
-                std::shared_ptr<const Graph> g = prob->graphs.at(*vcit);
-                const auto &erased = local_erased_edges.at(*vcit);
-                ExactSolver esolv(g, erased);
-                auto sols = esolv.solve(max_time_spent_by_exact_solver);
-                e_sols->insert(e_sols->end(), sols.begin(), sols.end());
-            }
-        }
+                    if(valid_sols.size() > 0) {
+                        found[i] = valid_sols;
+                        found_origin[i] = origin_of(stage);
+                        n_found += valid_sols.size();
 
-        for(const auto &s : *e_sols) {
-            if(s.reduced_cost > 0.0) {
-                discarded_prc++;
-            } else if(find(valid_sols.begin(), valid_sols.end(), s) != valid_sols.end()) {
-                discarded_generated++;
-            } else if(solution_in_pool(s, node_pool)) {
-                discarded_in_pool++;
-            } else {
-                valid_sols.push_back(s);
+                        // Enough columns: stop the other racers
+                        if(n_found >= target) { race_cancellation.cancel(); }
+                        return;
+                    }
+
+                    // The complete labelling only needs to prove that there are no new columns if no racer found any
+                    if(stage != PricingStage::SPPRC || prove_optimality || discarded.negative == 0 || n_found > 0u) { break; }
+
+                    prove_optimality = true;
+                }
             }
+        };
 
-            if(PEDANTIC) { assert(s.satisfies_capacity_constraints()); }
-        }
+        prob->pricing_pool->parallel_for(racers.size(), run_racer);
 
-        if(PEDANTIC) {
-            print_report(valid_sols.size(), discarded_prc, discarded_infeasible, discarded_generated, discarded_in_pool);
-        }
+        // As in the cascade, the origin is that of the first stage which found columns
+        auto cols = std::vector<Column>();
+        auto origin = ColumnOrigin::NONE;
 
-        if(valid_sols.size() > 0) {
-            for(const auto &s : valid_sols) {
-                Column col(prob, s, ColumnOrigin::SPPRC);
-                node_pool.push_back(col);
-                global_pool->push_back(col);
-            }
-            return std::make_pair(valid_sols.size(), ColumnOrigin::SPPRC);
+        for(auto i = 0u; i < racers.size(); i++) {
+            if(found[i].empty()) { continue; }
+
+            for(const auto &s : found[i]) { cols.emplace_back(prob, s, found_origin[i]); }
+            if(origin == ColumnOrigin::NONE) { origin = found_origin[i]; }
         }
 
-        return std::make_pair(0, ColumnOrigin::NONE);
+        if(cols.empty()) { return std::make_pair(0, ColumnOrigin::NONE); }
+
+        return std::make_pair(add_columns(cols, node_pool, node_index, global_pool, global_index), origin);
     }
 }
@@ -5,28 +5,133 @@
 #ifndef SP_SOLVER_H
 #define SP_SOLVER_H
 
+#include <iostream>
+#include <memory>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
+#include "../base/cancellation.h"
 #include "../base/problem.h"
 #include "../column/column_pool.h"
+#include "../column/solution_index.h"
 #include "heuristics_solver.h"
 #include "exact_solver.h"
+#include "labelling_stats.h"
+#include "stage_scheduler.h"
 
 namespace mvrp {
+    /* Minimum reduced cost of a route of each vessel class */
+    using MinReducedCosts = std::unordered_map<std::shared_ptr<VesselClass>, double>;
+
     class SPSolver {
     public:
         std::shared_ptr<const Problem> prob;
         const ErasedEdgesMap &local_erased_edges;
 
-        SPSolver(std::shared_ptr<const Problem> prob, const ErasedEdgesMap &local_erased_edges) : prob(prob), local_erased_edges{local_erased_edges} {}
+        /* Critical ports for the DSSR elementary labelling, one entry per vessel class. */
+        CriticalPortsMap &critical_ports;
+
+        /* If not null, the statistics of all the labelling runs are added to it. */
+        LabellingStats *labelling_stats;
+
+        /* Number of the B&B node, used to seed the random choices of the heuristics. */
+        unsigned int node_number;
+
+        /* If not null, whenever the complete labelling runs to completion on a vessel class, the minimum reduced
+         * cost of the routes of that class (or zero, if it is positive) is written in it. */
+        MinReducedCosts *min_reduced_costs;
+
+        /* All the pricing stages, in the order in which they are tried unless the stage scheduler reorders them */
+        static const std::vector<PricingStage> stages;
+
+        SPSolver(std::shared_ptr<const Problem> prob, const ErasedEdgesMap &local_erased_edges, CriticalPortsMap &critical_ports, LabellingStats *labelling_stats = nullptr, unsigned int node_number = 0u, MinReducedCosts *min_reduced_costs = nullptr) : prob(prob), local_erased_edges{local_erased_edges}, critical_ports{critical_ports}, labelling_stats{labelling_stats}, node_number{node_number}, min_reduced_costs{min_reduced_costs} {}
 
-        /* Returns how many columns were added to the column pool and their origin */
-        std::pair<int, ColumnOrigin> solve(ColumnPool &node_pool, std::shared_ptr<ColumnPool> global_pool, bool try_elementary, double &time_spent_by_exact_solver) const;
+        /* Returns how many columns were added to the column pool and their origin. If the cancellation
+         * token is cancelled, returns the columns found so far: in this case, if no column is returned,
+         * it does not mean that there is no column with negative reduced cost. The base routes (those
+         * in the current LP solution) are the starting points of the local search. The indices must
+         * contain the solutions of the respective pools, and are updated with the new columns. */
+        std::pair<int, ColumnOrigin> solve(ColumnPool &node_pool, SolutionIndex &node_index, std::shared_ptr<ColumnPool> global_pool, std::shared_ptr<SolutionIndex> global_index, const std::vector<Solution> &base_routes, bool try_elementary, double &time_spent_by_exact_solver, const CancellationToken &cancellation = CancellationToken()) const;
+
+        /* Origin of the columns found by a pricing stage */
+        static ColumnOrigin origin_of(PricingStage stage);
 
     private:
-        bool solution_in_pool(const Solution &s, const ColumnPool &pool) const;
-        void print_report(int sols_found, int discarded_prc, int discarded_infeasible, int discarded_generated, int discarded_in_pool, std::ostream &out = std::cerr) const;
+        /* Columns found by a stage which cannot be added to the pool, by reason */
+        struct Discarded {
+            int prc = 0;
+            int infeasible = 0;
+            int generated = 0;
+            int in_pool = 0;
+
+            /* Those among the already generated or pooled ones with negative reduced cost. The budgeted labelling
+             * keeps the best exact_pricing_max_columns labels even when it does not stop early, so any of them
+             * might have pushed out a new negative column. */
+            int negative = 0;
+        };
+
+        /* Calls f(vc) for each given vessel class: in parallel on the pricing pool if parallel_labelling is set,
+         * and sequentially otherwise. */
+        template<typename F>
+        void for_each_vessel_class(const std::vector<std::shared_ptr<VesselClass>> &vcs, F&& f) const;
+
+        /* Reduced cost under which a column of the global pool is brought into the node pool */
+        static constexpr double pool_rc_threshold = -0.000001;
+
+        /* Columns of the global pool which are not in the node pool, do not use edges erased at
+         * this node, and have negative reduced cost under the current duals */
+        std::vector<Column> price_global_pool(const ColumnPool &global_pool, const SolutionIndex &node_index) const;
+
+        bool is_enabled(PricingStage stage, const std::vector<Solution> &base_routes, bool try_elementary) const;
+
+        /* Runs a stage on the given vessel classes and gives all the routes it found. The statistics of the labelling
+         * runs are added to stats, and the time spent on each vessel class to vc_times. */
+        std::vector<Solution> run_stage(PricingStage stage, const std::vector<std::shared_ptr<VesselClass>> &vcs, const std::vector<Solution> &base_routes, bool prove_optimality, double &max_time_spent_by_exact_solver, const CancellationToken &cancellation, LabellingStats &stats, VesselClassTimes &vc_times) const;
+
+        /* Runs a stage on the given vessel classes and gives the routes which can become new columns. The complete
+         * labelling runs again to completion if it might have stopped early because of columns we had to discard. */
+        std::vector<Solution> price(PricingStage stage, const std::vector<std::shared_ptr<VesselClass>> &vcs, const SolutionIndex &node_index, const std::vector<Solution> &base_routes, double &max_time_spent_by_exact_solver, const CancellationToken &cancellation, ConcurrentSolutionIndex &generated) const;
+
+        /* Runs a stage on one vessel class at a time, and stops at the first one which yields at least
+         * partial_pricing_min_columns new columns. Gives the new columns found by all the classes priced. */
+        std::vector<Solution> price_partially(PricingStage stage, const SolutionIndex &node_index, const std::vector<Solution> &base_routes, double &max_time_spent_by_exact_solver, const CancellationToken &cancellation, ConcurrentSolutionIndex &generated) const;
+
+        /* The enabled stages, in the order in which they should be tried */
+        std::vector<PricingStage> scheduled_stages(const std::vector<Solution> &base_routes, bool try_elementary) const;
+
+        /* Routes found by a stage which can become new columns. They are added to the generated ones. */
+        std::vector<Solution> new_solutions(PricingStage stage, const std::vector<Solution> &sols, const SolutionIndex &node_index, ConcurrentSolutionIndex &generated, Discarded &discarded) const;
+
+        /* At most max_columns_per_iteration of the columns, if it is positive. The most negative column comes first,
+         * then those which cover some port not covered by the columns already selected, in order of reduced cost;
+         * the room left, if any, goes to the most negative of the others. */
+        std::vector<Column> select_columns(std::vector<Column> cols) const;
+
+        /* Adds the new columns to the global pool, and those selected by select_columns to the node pool. The others
+         * stay in the global pool, whose columns are priced again at the next iteration. Gives the number of columns
+         * added to the node pool. */
+        int add_columns(const std::vector<Column> &cols, ColumnPool &node_pool, SolutionIndex &node_index, ColumnPool &global_pool, SolutionIndex &global_index) const;
+
+        /* Tries one stage after the other, and stops at the first one which finds new columns. With partial pricing,
+         * each stage prices the vessel classes one at a time. */
+        std::pair<int, ColumnOrigin> solve_cascade(ColumnPool &node_pool, SolutionIndex &node_index, ColumnPool &global_pool, SolutionIndex &global_index, const std::vector<Solution> &base_routes, bool try_elementary, double &max_time_spent_by_exact_solver, const CancellationToken &cancellation, ConcurrentSolutionIndex &generated) const;
+
+        /* Runs all stages at the same time on the pricing pool, and stops them as soon as they have found
+         * racing_target_columns new columns in total. If they find none, the complete labelling runs to the end. */
+        std::pair<int, ColumnOrigin> solve_race(ColumnPool &node_pool, SolutionIndex &node_index, ColumnPool &global_pool, SolutionIndex &global_index, const std::vector<Solution> &base_routes, bool try_elementary, double &max_time_spent_by_exact_solver, const CancellationToken &cancellation, ConcurrentSolutionIndex &generated) const;
+
+        void print_report(const std::vector<Solution> &sols_found, const Discarded &discarded, std::ostream &out = std::cerr) const;
     };
+
+    template<typename F>
+    void SPSolver::for_each_vessel_class(const std::vector<std::shared_ptr<VesselClass>> &vcs, F&& f) const {
+        if(prob->params.parallel_labelling) {
+            prob->pricing_pool->parallel_for(vcs.size(), [&] (std::size_t i) { f(vcs[i]); });
+        } else {
+            for(const auto &vc : vcs) { f(vc); }
+        }
+    }
 }
 
 #endif
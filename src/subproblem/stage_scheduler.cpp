@@ -0,0 +1,155 @@
+//  Created by Alberto Santini on 18/09/13.
+//  Copyright (c) 2013 Alberto Santini. All rights reserved.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+
+#include "stage_scheduler.h"
+
+namespace mvrp {
+    std::ostream &operator<<(std::ostream &out, PricingStage stage) {
+        switch(stage) {
+            case PricingStage::LOCAL_SEARCH: out << "Local search on the base routes"; break;
+            case PricingStage::FAST_H: out << "Fast heuristic"; break;
+            case PricingStage::ESPPRC_CP: out << "Elementary labelling C+P"; break;
+            case PricingStage::ESPPRC_P: out << "Elementary labelling P"; break;
+            case PricingStage::SPPRC_SPARSE: out << "Labelling on the sparse graph"; break;
+            case PricingStage::SPPRC_SMART: out << "Labelling on the P-reduced graph"; break;
+            case PricingStage::SPPRC_RED: out << "Labelling on the (C+P)-reduced graph"; break;
+            case PricingStage::SPPRC_BEAM: out << "Beam labelling on the complete graph"; break;
+            case PricingStage::SPPRC: out << "Labelling on the complete graph"; break;
+        }
+        return out;
+    }
+
+    double StageScheduler::success_bound(const Record &r) const {
+        if(r.runs == 0u) { return 1.0; }
+
+        auto rate = static_cast<double>(r.successes) / r.runs;
+        auto bonus = exploration * std::sqrt(std::log(static_cast<double>(total_runs)) / r.runs);
+
+        return std::min(rate + bonus, 1.0);
+    }
+
+    std::vector<PricingStage> StageScheduler::schedule(const std::vector<PricingStage> &enabled) {
+        std::lock_guard<std::mutex> guard(mtx);
+
+        auto exact_enabled = std::find(enabled.begin(), enabled.end(), PricingStage::SPPRC) != enabled.end();
+        const auto &exact = records[PricingStage::SPPRC];
+        auto order = std::vector<PricingStage>();
+        auto skipped = std::vector<PricingStage>();
+
+        for(auto stage : enabled) {
+            if(stage == PricingStage::SPPRC) { continue; }
+
+            const auto &r = records[stage];
+
+            // Until the complete labelling has run, we have nothing to compare with
+            if(exact_enabled && r.runs > 0u && exact.runs > 0u && r.mean_time() >= success_bound(r) * exact.mean_time()) {
+                skipped.push_back(stage);
+            } else {
+                order.push_back(stage);
+            }
+        }
+
+        // Expected time per success; stages never tried come first
+        auto expected_time = [&] (PricingStage stage) {
+            const auto &r = records[stage];
+            return r.mean_time() / std::max(success_bound(r), std::numeric_limits<double>::epsilon());
+        };
+
+        std::stable_sort(order.begin(), order.end(), [&] (PricingStage s1, PricingStage s2) { return expected_time(s1) < expected_time(s2); });
+
+        if(exact_enabled) { order.push_back(PricingStage::SPPRC); }
+
+        if(PEDANTIC || order != last_order || skipped != last_skipped) {
+            std::cerr << "\t\tPricing schedule:";
+            for(auto stage : order) { std::cerr << " [" << stage << "]"; }
+            if(!skipped.empty()) {
+                std::cerr << "; skipped:";
+                for(auto stage : skipped) { std::cerr << " [" << stage << "]"; }
+            }
+            std::cerr << std::endl;
+
+            last_order = order;
+            last_skipped = skipped;
+        }
+
+        return order;
+    }
+
+    void StageScheduler::record(PricingStage stage, double time, const std::vector<Solution> &new_sols, const VesselClassTimes &vc_times) {
+        std::lock_guard<std::mutex> guard(mtx);
+
+        auto &r = records[stage];
+        r.runs++;
+        r.time += time;
+        r.columns += new_sols.size();
+        if(!new_sols.empty()) { r.successes++; }
+        total_runs++;
+
+        for(const auto &vt : vc_times) {
+            auto n_columns = std::count_if(new_sols.begin(), new_sols.end(), [&] (const Solution &s) { return s.vessel_class == vt.first; });
+            auto &vr = vc_records[std::make_pair(stage, vt.first->name)];
+
+            vr.runs++;
+            vr.time += vt.second;
+            vr.columns += n_columns;
+            if(n_columns > 0) { vr.successes++; }
+        }
+    }
+
+    std::vector<std::shared_ptr<VesselClass>> VesselClassScheduler::order() const {
+        std::lock_guard<std::mutex> guard(mtx);
+
+        auto vcs = std::vector<std::shared_ptr<VesselClass>>();
+        for(auto i = 0u; i < vessel_classes.size(); i++) { vcs.push_back(vessel_classes[(next + i) % vessel_classes.size()]); }
+
+        if(policy == PartialPricing::RECENT_SUCCESS) {
+            auto recent = [&] (const std::shared_ptr<VesselClass> &vc) {
+                auto it = recent_columns.find(vc);
+                return it == recent_columns.end() ? 0.0 : it->second;
+            };
+
+            // Ties are broken in round-robin order
+            std::stable_sort(vcs.begin(), vcs.end(), [&] (const std::shared_ptr<VesselClass> &vc1, const std::shared_ptr<VesselClass> &vc2) { return recent(vc1) > recent(vc2); });
+        }
+
+        return vcs;
+    }
+
+    void VesselClassScheduler::record(const std::shared_ptr<VesselClass> &vc, std::size_t n_columns, bool enough) {
+        std::lock_guard<std::mutex> guard(mtx);
+
+        auto &recent = recent_columns[vc];
+        recent = decay * recent + (1.0 - decay) * n_columns;
+
+        if(enough) {
+            auto it = std::find(vessel_classes.begin(), vessel_classes.end(), vc);
+            if(it != vessel_classes.end()) { next = (std::distance(vessel_classes.begin(), it) + 1u) % vessel_classes.size(); }
+        }
+    }
+
+    std::ostream &operator<<(std::ostream &out, const StageScheduler &scheduler) {
+        std::lock_guard<std::mutex> guard(scheduler.mtx);
+
+        out << "Pricing stages (runs, successes, columns, mean time):" << std::endl;
+        for(const auto &sr : scheduler.records) {
+            const auto &r = sr.second;
+            if(r.runs == 0u) { continue; }
+
+            out << "\t" << sr.first << ": " << r.runs << ", " << r.successes << ", " << r.columns << ", " << r.mean_time() << std::endl;
+
+            for(const auto &vr : scheduler.vc_records) {
+                if(vr.first.first != sr.first) { continue; }
+                out << "\t\t" << vr.first.second << ": " << vr.second.runs << ", " << vr.second.successes << ", "
+                    << vr.second.columns << ", " << vr.second.mean_time() << std::endl;
+            }
+        }
+
+        return out;
+    }
+}
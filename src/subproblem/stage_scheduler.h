@@ -0,0 +1,131 @@
+//  Created by Alberto Santini on 18/09/13.
+//  Copyright (c) 2013 Alberto Santini. All rights reserved.
+//
+
+#ifndef STAGE_SCHEDULER_H
+#define STAGE_SCHEDULER_H
+
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../base/vessel_class.h"
+#include "../column/solution.h"
+#include "../preprocessing/program_params.h"
+
+namespace mvrp {
+    /* Pricing algorithms, in the order in which they are tried */
+    enum class PricingStage {
+        LOCAL_SEARCH, FAST_H, ESPPRC_CP, ESPPRC_P, SPPRC_SPARSE, SPPRC_SMART, SPPRC_RED, SPPRC_BEAM, SPPRC
+    };
+
+    std::ostream &operator<<(std::ostream &out, PricingStage stage);
+
+    /* Time spent by a pricing stage on each vessel class */
+    using VesselClassTimes = std::unordered_map<std::shared_ptr<VesselClass>, double>;
+
+    /**
+     * Learns, over the whole run, which pricing stages are worth trying. Every run of a stage is recorded
+     * with the time it took and the new columns it found, both in total and per vessel class. Each stage is
+     * an arm of a bandit: its probability of finding columns is estimated optimistically (UCB1), so that
+     * stages which have not been tried for a while get tried again. The stages are tried in increasing
+     * order of expected time per success, which minimises the expected time to the first success; a stage
+     * is skipped if trying it before the complete labelling does not pay off on average, i.e. if its mean
+     * time exceeds its success probability times the mean time of the complete labelling. The complete
+     * labelling is never skipped, and always comes last.
+     * It can be used by several pricing threads at the same time.
+     */
+    class StageScheduler {
+        struct Record {
+            unsigned int runs = 0u;
+            unsigned int successes = 0u;
+            unsigned long columns = 0ul;
+            double time = 0.0;
+
+            double mean_time() const { return runs > 0u ? time / runs : 0.0; }
+        };
+
+        /* Weight of the exploration term of the success bound */
+        double exploration;
+
+        std::map<PricingStage, Record> records;
+        std::map<std::pair<PricingStage, std::string>, Record> vc_records;
+        unsigned int total_runs;
+
+        /* Last schedule given, to only log the changes */
+        std::vector<PricingStage> last_order;
+        std::vector<PricingStage> last_skipped;
+
+        mutable std::mutex mtx;
+
+        double success_bound(const Record &r) const;
+
+    public:
+        explicit StageScheduler(double exploration) : exploration{exploration}, total_runs{0u} {}
+
+        /**
+         * Gives the stages to try, in the order in which they should be tried.
+         * @param enabled   The stages enabled at this iteration, in their default order
+         * @return          The stages to try, ending with the complete labelling if it is enabled
+         */
+        std::vector<PricingStage> schedule(const std::vector<PricingStage> &enabled);
+
+        /**
+         * Records a completed run of a stage.
+         * @param stage     The stage
+         * @param time      Wall-clock time of the run
+         * @param new_sols  Routes found by the stage which became new columns
+         * @param vc_times  Time spent by the stage on each vessel class
+         */
+        void record(PricingStage stage, double time, const std::vector<Solution> &new_sols, const VesselClassTimes &vc_times);
+
+        friend std::ostream &operator<<(std::ostream &out, const StageScheduler &scheduler);
+    };
+
+    /**
+     * Order in which partial pricing goes through the vessel classes, over the whole run. With round robin,
+     * it starts from the class after the last one which yielded enough columns. With recent success, the
+     * classes which yielded the most columns recently (as an exponential moving average) come first.
+     * It can be used by several pricing threads at the same time.
+     */
+    class VesselClassScheduler {
+        PartialPricing policy;
+        std::vector<std::shared_ptr<VesselClass>> vessel_classes;
+
+        /* Position in vessel_classes of the class from which round robin starts */
+        std::size_t next;
+
+        /* Moving average of the columns found by each class */
+        std::unordered_map<std::shared_ptr<VesselClass>, double> recent_columns;
+
+        /* Weight of the past in the moving average */
+        static constexpr double decay = 0.5;
+
+        mutable std::mutex mtx;
+
+    public:
+        VesselClassScheduler(PartialPricing policy, const std::vector<std::shared_ptr<VesselClass>> &vessel_classes) :
+                             policy{policy}, vessel_classes{vessel_classes}, next{0u} {}
+
+        /**
+         * Gives all the vessel classes, in the order in which they should be priced.
+         */
+        std::vector<std::shared_ptr<VesselClass>> order() const;
+
+        /**
+         * Records that a vessel class has been priced.
+         * @param vc        The vessel class
+         * @param n_columns Number of new columns it yielded
+         * @param enough    Whether these columns were enough to stop pricing
+         */
+        void record(const std::shared_ptr<VesselClass> &vc, std::size_t n_columns, bool enough);
+    };
+}
+
+#endif